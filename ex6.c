@@ -1,17 +1,31 @@
+#define _POSIX_C_SOURCE 200809L //write(), isatty(), mmap()
 #include "ex6.h"
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-# define INT_BUFFER 128
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 // ================================================
 // Basic struct definitions from ex6.h assumed:
 //   PokemonData { int id; char *name; PokemonType TYPE; int hp; int attack; EvolutionStatus CAN_EVOLVE; }
 //   PokemonNode { PokemonData* data; PokemonNode* left, *right; }
 //   OwnerNode   { char* ownerName; PokemonNode* pokedexRoot; OwnerNode *next, *prev; }
-//   OwnerNode* ownerHead;
+//   Session     { ...; OwnerNode* ownerHead; ... }   (one per script, passed to everything)
 //   const PokemonData pokedex[];
 // ================================================
 
@@ -19,27 +33,19 @@
 // 1) Safe integer reading
 // --------------------------------------------------------------
 
-void trimWhitespace(char *str)
+char *trimWhitespace(char *str)
 {
-    // Remove leading spaces/tabs/\r
-    int start = 0;
-    while (str[start] == ' ' || str[start] == '\t' || str[start] == '\r')
-        start++;
-
-    if (start > 0)
-    {
-        int idx = 0;
-        while (str[start])
-            str[idx++] = str[start++];
-        str[idx] = '\0';
-    }
+    // Skip leading spaces/tabs/\r (no shifting, we just start later)
+    while (*str == ' ' || *str == '\t' || *str == '\r')
+        str++;
 
     // Remove trailing spaces/tabs/\r
-    int len = (int)strlen(str);
+    size_t len = strlen(str);
     while (len > 0 && (str[len - 1] == ' ' || str[len - 1] == '\t' || str[len - 1] == '\r'))
     {
         str[--len] = '\0';
     }
+    return str;
 }
 
 char *myStrdup(const char *src)
@@ -50,63 +56,417 @@ char *myStrdup(const char *src)
     char *dest = (char *)malloc(len + 1);
     if (!dest)
     {
-        printf("Memory allocation failed in myStrdup.\n");
+        fputs("Memory allocation failed in myStrdup.\n", stderr);
         return NULL;
     }
     strcpy(dest, src);
     return dest;
 }
 
-int readIntSafe(const char *prompt)
+int readIntSafe(Session *session, const char *prompt)
 {
-    char buffer[INT_BUFFER];
     int value;
     int success = 0;
 
     while (!success)
     {
-        printf("%s", prompt);
+        OutPrompt(session, prompt);
+        OutFlushBeforeInput(session);
 
-        // If we fail to read, treat it as invalid
-        if (!fgets(buffer, sizeof(buffer), stdin))
+        char *line = NextLine(session);
+        if (line == NULL)
+            EndOfInput(session); // nothing left to read, doesn't return
+
+        // 1) Strip a trailing \r so "123\r\n" becomes "123"
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r')
+            line[--len] = '\0';
+
+        // 2) Check if empty after stripping, then parse the whole line
+        if (len == 0 || !ParseIntLine(line, &value))
         {
-            printf("Invalid input.\n");
-            clearerr(stdin);
-            continue;
+            OutStr(session, "Invalid input.\n");
+        }
+        else
+        {
+            // We got a valid integer
+            success = 1;
         }
+    }
+    return value;
+}
+
+int ParseIntLine(const char *str, int *value)
+{
+    while (*str == ' ' || *str == '\t' || *str == '\r' || *str == '\v' || *str == '\f')
+        str++; // leading blanks are fine (strtol allowed them too)
+    int negative = 0;
+    if (*str == '+' || *str == '-')
+        negative = (*str++ == '-');
+    if (*str < '0' || *str > '9')
+        return 0;
+    long long number = 0;
+    while (*str >= '0' && *str <= '9')
+    {
+        if (number <= (long long)INT_MAX + 1) // stop growing once it can't fit anyway
+            number = number * 10 + (*str - '0');
+        str++;
+    }
+    if (*str != '\0')
+        return 0; // leftover chars => invalid
+    if (negative)
+        number = -number;
+    if (number > INT_MAX)
+        number = INT_MAX;
+    if (number < INT_MIN)
+        number = INT_MIN;
+    *value = (int)number;
+    return 1;
+}
 
-        // 1) Strip any trailing \r or \n
-        //    so "123\r\n" becomes "123"
-        size_t len = strlen(buffer);
-        if (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r'))
-            buffer[--len] = '\0';
-        if (len > 0 && (buffer[len - 1] == '\r' || buffer[len - 1] == '\n'))
-            buffer[--len] = '\0';
+// --------------------------------------------------------------
+// 1a) Input reader
+// --------------------------------------------------------------
 
-        // 2) Check if empty after stripping
-        if (len == 0)
+void InitInput(Session *session)
+{
+    InputReader *input = &session->input;
+    struct stat info;
+    if (fstat(input->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        size_t size = (size_t)info.st_size;
+        // private writable mapping: lines get their '\n' turned into '\0' right in the pages
+        char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, input->fd, 0);
+        if (data != MAP_FAILED && data[size - 1] == '\n') // last line needs a '\n' to become a string
         {
-            printf("Invalid input.\n");
-            continue;
+            input->data = data;
+            input->length = size;
+            input->mapped = 1;
+            input->eof = 1;
+            return;
         }
+        if (data != MAP_FAILED)
+            munmap(data, size);
+    }
+    input->capacity = INPUT_CHUNK_SIZE;
+    input->data = (char *)malloc(input->capacity + 1); // +1 so a last line without '\n' can still be terminated
+    if (input->data == NULL)
+    {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+}
 
-        // 3) Attempt to parse integer with strtol
-        char *endptr;
-        value = (int)strtol(buffer, &endptr, 10);
+// read() more bytes after the unconsumed ones; 0 once there's nothing left
+static int FillInput(Session *session)
+{
+    InputReader *input = &session->input;
+    if (input->eof)
+        return 0;
+    if (input->position > 0) // slide the unread tail to the front (old views die here)
+    {
+        memmove(input->data, input->data + input->position, input->length - input->position);
+        input->length -= input->position;
+        input->position = 0;
+    }
+    if (input->length == input->capacity) // one line bigger than the buffer
+    {
+        char *bigger = (char *)realloc(input->data, input->capacity * 2 + 1);
+        if (bigger == NULL)
+        {
+            OutStr(session, "Memory allocation failed.\n");
+            exit(1);
+        }
+        input->data = bigger;
+        input->capacity *= 2;
+    }
+    ssize_t n;
+    do
+    {
+        n = read(input->fd, input->data + input->length, input->capacity - input->length);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0)
+    {
+        input->eof = 1;
+        return 0;
+    }
+    input->length += (size_t)n;
+    return 1;
+}
 
-        // If endptr didn't point to the end => leftover chars => invalid
-        // or if buffer was something non-numeric
-        if (*endptr != '\0')
+char *NextLine(Session *session)
+{
+    InputReader *input = &session->input;
+    size_t scanned = input->position;
+    while (1)
+    {
+        char *newline = memchr(input->data + scanned, '\n', input->length - scanned);
+        if (newline != NULL)
         {
-            printf("Invalid input.\n");
+            char *line = input->data + input->position;
+            *newline = '\0';
+            input->position = (size_t)(newline - input->data) + 1;
+            return line;
+        }
+        size_t offset = input->length - input->position; // how far we already looked
+        if (!FillInput(session))
+            break;
+        scanned = input->position + offset;
+    }
+    if (input->position >= input->length)
+        return NULL;
+    char *line = input->data + input->position; // last line without '\n' (only when reading, never mapped)
+    input->data[input->length] = '\0';
+    input->position = input->length;
+    return line;
+}
+
+int NextChar(Session *session)
+{
+    InputReader *input = &session->input;
+    if (input->position >= input->length && !FillInput(session))
+        return EOF;
+    return (unsigned char)input->data[input->position++];
+}
+
+void CloseInput(Session *session)
+{
+    InputReader *input = &session->input;
+    if (input->mapped)
+        munmap(input->data, input->length);
+    else
+        free(input->data);
+    input->data = NULL;
+    input->length = input->position = input->capacity = 0;
+    input->mapped = 0;
+}
+
+void EndOfInput(Session *session)
+{
+    longjmp(session->endOfInput, 1); //RunSession() does the cleanup, other sessions keep going
+}
+
+void ShutdownProgram(Session *session)
+{
+    if (memoryReport) { //while the owners are still there
+        OutFlush(session);
+        PrintMemoryReport(session);
+    }
+    FinishCheckpoint(session, 1); //a checkpoint still being written gets to finish
+    if (session->registry->journal != NULL) //whatever is still pending gets committed
+        CloseJournal(session);
+    FreeAllOwners(session);
+    FreeMemoryPools(session); //owners + node blocks
+    pthread_mutex_destroy(&session->registry->memoryPools.spareLock);
+    pthread_mutex_destroy(&session->registry->memoryPools.sharedLock);
+    pthread_mutex_destroy(&session->registry->checkpoint.lock);
+    free(session->ownerNames); //only still there if the input ended in the middle of a merge
+    session->ownerNames = NULL;
+    CloseInput(session);
+    OutFlush(session);
+}
+
+// --------------------------------------------------------------
+// 1b) Buffered output
+// --------------------------------------------------------------
+
+void OutFlush(Session *session) {
+    OutputBuffer *output = &session->output;
+    int written = 0;
+    while (written < output->length) { //write() may take less than everything
+        ssize_t n = write(output->fd, output->data + written, (size_t)(output->length - written));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break; //nowhere to write, drop it
+        }
+        written += (int)n;
+    }
+    output->length = 0;
+}
+
+void OutFlushBeforeInput(Session *session) {
+    if (session->registry->journal != NULL) //a good moment to commit: we're about to wait anyway
+        JournalSync(session);
+    if (session->output.interactive && !session->output.batch)
+        OutFlush(session);
+}
+
+void OutPrompt(Session *session, const char *str) {
+    if (!session->output.batch)
+        OutStr(session, str);
+}
+
+void OutStr(Session *session, const char *str) {
+    OutputBuffer *output = &session->output;
+    size_t len = strlen(str);
+    while (len > 0) {
+        size_t room = (size_t)(OUTPUT_BUFFER_SIZE - output->length);
+        if (room == 0) {
+            OutFlush(session);
+            continue;
+        }
+        size_t chunk = len < room ? len : room;
+        memcpy(output->data + output->length, str, chunk);
+        output->length += (int)chunk;
+        str += chunk;
+        len -= chunk;
+    }
+}
+
+void OutChar(Session *session, char c) {
+    OutputBuffer *output = &session->output;
+    if (output->length == OUTPUT_BUFFER_SIZE)
+        OutFlush(session);
+    output->data[output->length++] = c;
+}
+
+void OutInt(Session *session, int value) {
+    OutputBuffer *output = &session->output;
+    char digits[12]; //"-2147483648" is 11 chars
+    int i = sizeof(digits);
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do { //digits come out backwards so fill from the end
+        digits[--i] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+        digits[--i] = '-';
+    if (output->length + (int)sizeof(digits) > OUTPUT_BUFFER_SIZE)
+        OutFlush(session);
+    memcpy(output->data + output->length, digits + i, sizeof(digits) - (size_t)i);
+    output->length += (int)sizeof(digits) - i;
+}
+
+void OutPrintf(Session *session, const char *format, ...) {
+    OutputBuffer *output = &session->output;
+    va_list args;
+    va_start(args, format);
+    int room = OUTPUT_BUFFER_SIZE - output->length;
+    int needed = vsnprintf(output->data + output->length, (size_t)room, format, args);
+    va_end(args);
+    if (needed < 0)
+        return;
+    if (needed < room) { //fit on the first try, the usual case
+        output->length += needed;
+        return;
+    }
+    OutFlush(session); //didn't fit: flush and format again (into a temp buffer if it's huge)
+    va_start(args, format);
+    if (needed < OUTPUT_BUFFER_SIZE) {
+        vsnprintf(output->data, OUTPUT_BUFFER_SIZE, format, args);
+        output->length = needed;
+    }
+    else {
+        char *big = (char *)malloc((size_t)needed + 1);
+        if (big != NULL) {
+            vsnprintf(big, (size_t)needed + 1, format, args);
+            OutStr(session, big);
+            free(big);
         }
+    }
+    va_end(args);
+}
+
+// --------------------------------------------------------------
+// 1c) Sessions
+// --------------------------------------------------------------
+
+void InitRegistry(OwnerRegistry *registry) {
+    memset(registry, 0, sizeof(*registry)); //no owners, empty pools
+    pthread_mutex_init(&registry->memoryPools.spareLock, NULL);
+    pthread_mutex_init(&registry->memoryPools.sharedLock, NULL);
+    pthread_mutex_init(&registry->checkpoint.lock, NULL);
+}
+
+void InitSession(Session *session, OwnerRegistry *registry, int inputFd, int outputFd) {
+    memset(session, 0, sizeof(*session)); //nothing read, nothing buffered
+    session->registry = registry;
+    session->input.fd = inputFd;
+    session->output.fd = outputFd;
+    session->output.batch = batchMode;
+    session->threads = workerThreads;
+    session->snapshot = mappedSnapshot.data != NULL ? &mappedSnapshot : NULL;
+}
+
+void RunSession(Session *session) {
+    InitInput(session);
+    if (setjmp(session->endOfInput) == 0) {
+        if (session->snapshot != NULL)
+            SnapshotMainMenu(session);
         else
-        {
-            // We got a valid integer
-            success = 1;
+            MainMenu(session);
+    }
+    ShutdownProgram(session);
+}
+
+int ReplayScript(const char *path) {
+    int in = open(path, O_RDONLY);
+    if (in < 0) {
+        perror(path);
+        return 0;
+    }
+    char *outPath = SuffixedPath(NULL, path, ".out");
+    int out = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        perror(outPath);
+        free(outPath);
+        close(in);
+        return 0;
+    }
+    free(outPath);
+    OwnerRegistry registry;
+    InitRegistry(&registry);
+    Session session; //~70KB, fine on a pool thread's stack
+    InitSession(&session, &registry, in, out);
+    session.threads = 1; //the pool already keeps every CPU busy
+    RunSession(&session);
+    close(in);
+    close(out);
+    return 1;
+}
+
+void *SessionWorker(void *arg) {
+    SessionRunner *runner = (SessionRunner *)arg;
+    for (;;) {
+        pthread_mutex_lock(&runner->lock);
+        int script = runner->next++;
+        pthread_mutex_unlock(&runner->lock);
+        if (script >= runner->count)
+            break;
+        if (!ReplayScript(runner->scripts[script])) {
+            pthread_mutex_lock(&runner->lock);
+            runner->failed++;
+            pthread_mutex_unlock(&runner->lock);
         }
     }
-    return value;
+    return NULL;
+}
+
+int RunSessions(char **scripts, int count, int threads) {
+    SessionRunner runner;
+    runner.scripts = scripts;
+    runner.count = count;
+    runner.next = 0;
+    runner.failed = 0;
+    pthread_mutex_init(&runner.lock, NULL);
+    threads = ResolveThreads(threads, count);
+    pthread_t *workers = (pthread_t *)malloc(sizeof(pthread_t) * (size_t)threads);
+    if (workers == NULL) {
+        fputs("Memory allocation failed.\n", stderr);
+        exit(1);
+    }
+    int started = 0;
+    for (int t = 1; t < threads; t++) { //whatever doesn't start, the others pick up
+        if (pthread_create(&workers[started], NULL, SessionWorker, &runner) == 0)
+            started++;
+    }
+    SessionWorker(&runner);
+    for (int t = 0; t < started; t++)
+        pthread_join(workers[t], NULL);
+    free(workers);
+    pthread_mutex_destroy(&runner.lock);
+    return runner.failed;
 }
 
 // --------------------------------------------------------------
@@ -152,150 +512,131 @@ const char *getTypeName(PokemonType type)
 }
 
 // --------------------------------------------------------------
-// Utility: getDynamicInput (for reading a line into malloc'd memory)
+// Utility: getDynamicInput (a trimmed line, straight out of the input buffer)
 // --------------------------------------------------------------
-char *getDynamicInput()
+char *getDynamicInput(Session *session)
 {
-    char *input = NULL;
-    size_t size = 0, capacity = 1;
-    input = (char *)malloc(capacity);
-    if (!input)
-    {
-        printf("Memory allocation failed.\n");
-        return NULL;
-    }
-
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF)
-    {
-        if (size + 1 >= capacity)
-        {
-            capacity *= 2;
-            char *temp = (char *)realloc(input, capacity);
-            if (!temp)
-            {
-                printf("Memory reallocation failed.\n");
-                free(input);
-                return NULL;
-            }
-            input = temp;
-        }
-        input[size++] = (char)c;
-    }
-    input[size] = '\0';
+    OutFlushBeforeInput(session);
+    char *line = NextLine(session);
+    if (line == NULL)
+        EndOfInput(session);
 
     // Trim any leading/trailing whitespace or carriage returns
-    trimWhitespace(input);
-
-    return input;
+    return trimWhitespace(line);
 }
 
 // Function to print a single Pokemon node
 // --------------------------------------------------------------
 // Display Menu
 // --------------------------------------------------------------
-void DisplayMenu(OwnerNode *owner)
+void DisplayMenu(Session *session, OwnerNode *owner)
 {
-    if (owner->pokedexRoot == NULL)
+    if (OwnerPokemonCount(owner) == 0)
     {
-        printf("Pokedex is empty.\n");
+        OutStr(session, "Pokedex is empty.\n");
         return;
     }
 
-    printf("Display:\n");
-    printf("1. BFS (Level-Order)\n");
-    printf("2. Pre-Order\n");
-    printf("3. In-Order\n");
-    printf("4. Post-Order\n");
-    printf("5. Alphabetical (by name)\n");
+    OutPrompt(session, "Display:\n");
+    OutPrompt(session, "1. BFS (Level-Order)\n");
+    OutPrompt(session, "2. Pre-Order\n");
+    OutPrompt(session, "3. In-Order\n");
+    OutPrompt(session, "4. Post-Order\n");
+    OutPrompt(session, "5. Alphabetical (by name)\n");
 
-    int choice = readIntSafe("Your choice: ");
+    int choice = readIntSafe(session, "Your choice: ");
 
     switch (choice)
     {
     case 1:
-        DisplayBFS(owner->pokedexRoot);
+        DisplayPokedex(session, owner, ORDER_BFS);
         break;
     case 2:
-        PreOrderTraversal(owner->pokedexRoot);
+        DisplayPokedex(session, owner, ORDER_PRE);
         break;
     case 3:
-        InOrderTraversal(owner->pokedexRoot);
+        DisplayPokedex(session, owner, ORDER_IN);
         break;
     case 4:
-        PostOrderTraversal(owner->pokedexRoot);
+        DisplayPokedex(session, owner, ORDER_POST);
         break;
     case 5:
-        DisplayAlphabetical(owner->pokedexRoot);
+        DisplayPokedexAlphabetical(session, owner);
         break;
     default:
-        printf("Invalid choice.\n");
+        OutStr(session, "Invalid choice.\n");
     }
 }
 
 // --------------------------------------------------------------
 // Sub-menu for existing Pokedex
 // --------------------------------------------------------------
-void EnterExistingPokedexMenu()
+void EnterExistingPokedexMenu(Session *session)
 {
+    if (session->snapshot != NULL) {
+        SnapshotPokedexMenu(session);
+        return;
+    }
     // list owners
-    if (ownerHead == NULL) {
-        printf("No existing Pokedexes.\n");
+    if (session->registry->ownerHead == NULL) {
+        OutStr(session, "No existing Pokedexes.\n");
         return;
     }
-    printf("\nExisting Pokedexes:\n");
-    int count = 1;
+    OutPrompt(session, "\nExisting Pokedexes:\n");
+    int count = OwnerCount(session);
     int choice;
-    OwnerNode *node = ownerHead;//first one in the list
-    do { //while the node is not first one
-        printf("%d. %s\n", count, node->ownerName);
-        node = node->next; //next one
-        count++;
-    } while (node != ownerHead);
-    printf("Choose a Pokedex by number: \n");
-    choice = readIntSafe("");
-    while (choice > count - 1 || choice < 1) {
-        printf("Invalid choice.\n");
-        choice = readIntSafe("");
-    }
-    OwnerNode *current = ListLookUp(choice);
-    printf("Entering %s's Pokedex...", current->ownerName);
+    if (!session->output.batch) //the numbered list is part of the menu
+        PrintOwnerList(session);
+    OutPrompt(session, "Choose a Pokedex by number: \n");
+    choice = readIntSafe(session, "");
+    while (choice > count || choice < 1) {
+        OutStr(session, "Invalid choice.\n");
+        choice = readIntSafe(session, "");
+    }
+    OwnerNode *current = ListLookUp(session, choice);
+    if (!session->output.batch)
+        OutPrintf(session, "Entering %s's Pokedex...", current->ownerName);
 
     int subChoice;
     do
     {
-        printf("\n-- %s's Pokedex Menu --\n", current->ownerName);
-        printf("1. Add Pokemon\n");
-        printf("2. Display Pokedex\n");
-        printf("3. Release Pokemon (by ID)\n");
-        printf("4. Pokemon Fight!\n");
-        printf("5. Evolve Pokemon\n");
-        printf("6. Back to Main\n");
+        if (!session->output.batch)
+            OutPrintf(session, "\n-- %s's Pokedex Menu --\n", current->ownerName);
+        OutPrompt(session, "1. Add Pokemon\n");
+        OutPrompt(session, "2. Display Pokedex\n");
+        OutPrompt(session, "3. Release Pokemon (by ID)\n");
+        OutPrompt(session, "4. Pokemon Fight!\n");
+        OutPrompt(session, "5. Evolve Pokemon\n");
+        OutPrompt(session, "6. Back to Main\n");
+        OutPrompt(session, "7. Tournament\n");
 
-        subChoice = readIntSafe("Your choice: ");
+        subChoice = readIntSafe(session, "Your choice: ");
 
         switch (subChoice)
         {
         case 1:
-            AddPokemon(current);
+            AddPokemon(session, current);
             break;
         case 2:
-            DisplayMenu(current);
+            DisplayMenu(session, current);
             break;
         case 3:
-            FreePokemon(current);
+            FreePokemon(session, current);
             break;
         case 4:
-            PokemonFight(current);
+            PokemonFight(session, current);
             break;
         case 5:
-            EvolvePokemon(current);
+            EvolvePokemon(session, current);
             break;
         case 6:
-            printf("Back to Main Menu.\n");
+            OutPrompt(session, "Back to Main Menu.\n");
+            break;
+        case 7:
+            TournamentMenu(session, current);
             break;
         default:
-            printf("Invalid choice.\n");
+            OutStr(session, "Invalid choice.\n");
         }
     } while (subChoice != 6);
 }
@@ -303,171 +644,537 @@ void EnterExistingPokedexMenu()
 // --------------------------------------------------------------
 // Main Menu
 // --------------------------------------------------------------
-void MainMenu()
+void MainMenu(Session *session)
 {
     int choice;
     do
     {
-        printf("\n=== Main Menu ===\n");
-        printf("1. New Pokedex\n");
-        printf("2. Existing Pokedex\n");
-        printf("3. Delete a Pokedex\n");
-        printf("4. Merge Pokedexes\n");
-        printf("5. Sort Owners by Name\n");
-        printf("6. Print Owners in a direction X times\n");
-        printf("7. Exit\n");
-        choice = readIntSafe("Your choice: ");
+        FinishCheckpoint(session, 0); //between commands, never halfway through one
+        if (session->registry->journal != NULL && JournalWantsCompaction(session->registry->journal))
+            CompactJournal(session, 1);
+        OutPrompt(session, "\n=== Main Menu ===\n");
+        OutPrompt(session, "1. New Pokedex\n");
+        OutPrompt(session, "2. Existing Pokedex\n");
+        OutPrompt(session, "3. Delete a Pokedex\n");
+        OutPrompt(session, "4. Merge Pokedexes\n");
+        OutPrompt(session, "5. Sort Owners by Name\n");
+        OutPrompt(session, "6. Print Owners in a direction X times\n");
+        OutPrompt(session, "7. Exit\n");
+        OutPrompt(session, "8. League\n");
+        OutPrompt(session, "9. Merge Many Pokedexes\n");
+        OutPrompt(session, "10. Save Snapshot\n");
+        OutPrompt(session, "11. Load Snapshot\n");
+        OutPrompt(session, "12. Checkpoint (save in the background)\n");
+        OutPrompt(session, "13. Clone a Pokedex\n");
+        OutPrompt(session, "14. Preview a Merge\n");
+        choice = readIntSafe(session, "Your choice: ");
+        double started = NowSeconds(); //a script's command, from its choice to its last line
 
         switch (choice)
         {
         case 1:
-            OpenPokedexMenu();
+            OpenPokedexMenu(session);
             break;
         case 2:
-            EnterExistingPokedexMenu();
+            EnterExistingPokedexMenu(session);
             break;
         case 3:
-            DeletePokedex();
+            DeletePokedex(session);
             break;
         case 4:
-            MergePokedexMenu();
+            MergePokedexMenu(session);
             break;
         case 5:
-            SortOwners();
+            SortOwners(session);
             break;
         case 6:
-            PrintOwnersCircular();
+            PrintOwnersCircular(session);
             break;
         case 7:
-            printf("Goodbye!\n");
+            OutPrompt(session, "Goodbye!\n");
+            break;
+        case 8:
+            LeagueMenu(session);
+            break;
+        case 9:
+            MergeManyMenu(session);
+            break;
+        case 10:
+            SaveSnapshotMenu(session);
+            break;
+        case 11:
+            LoadSnapshotMenu(session);
+            break;
+        case 12:
+            CheckpointMenu(session);
+            break;
+        case 13:
+            CloneOwnerMenu(session);
+            break;
+        case 14:
+            PreviewMergeMenu(session);
             break;
         default:
-            printf("Invalid.\n");
+            OutStr(session, "Invalid.\n");
         }
+        if (!session->output.interactive) //at a terminal it would mostly time the person typing
+            NoteCommandLatency(session->registry, NowSeconds() - started);
     } while (choice != 7);
 }
 
-int main()
+int ParseArguments(int argc, char **argv) {
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0) {
+            batchMode = 1;
+        }
+        else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--compact") == 0) {
+            pokedexLayout = LAYOUT_COMPACT;
+        }
+        else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--memory-report") == 0) {
+            memoryReport = 1;
+        }
+        else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc
+                 && ParseIntLine(argv[i + 1], &workerThreads) && workerThreads >= 0) {
+            i++;
+        }
+        else if ((strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "--serve") == 0) && i + 1 < argc) {
+            serveSocket = argv[++i];
+        }
+        else if ((strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "--load") == 0) && i + 1 < argc) {
+            loadSocket = argv[++i];
+        }
+        else if ((strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "--read-only") == 0) && i + 1 < argc) {
+            snapshotFile = argv[++i];
+        }
+        else if ((strcmp(argv[i], "-J") == 0 || strcmp(argv[i], "--journal") == 0) && i + 1 < argc) {
+            journalFile = argv[++i];
+        }
+        else {
+            break; //usage below
+        }
+    }
+    //the journal belongs to one live registry: not a mapped snapshot, not a set of scripts
+    if ((i < argc && argv[i][0] == '-')
+        || (journalFile != NULL && (snapshotFile != NULL || loadSocket != NULL || i < argc))) {
+        fprintf(stderr, "Usage: %s [-b|--batch] [-c|--compact] [-m|--memory-report] [-j|--threads N] "
+                        "[-R|--read-only SNAPSHOT] [script...] (no scripts: < script)\n"
+                        "       %s [-b] [-c] [-m] -J|--journal FILE < script\n"
+                        "       %s [-c] [-j N] [-J FILE] -S|--serve SOCKET\n"
+                        "       %s [-j CLIENTS] -L|--load SOCKET\n",
+                argv[0], argv[0], argv[0], argv[0]);
+        return 0;
+    }
+    return i; //scripts, if any, start here
+}
+
+static Session *exitSession; //the stdin session, so exit(1) paths still get their output out
+
+static void FlushAtExit(void) {
+    if (exitSession != NULL)
+        OutFlush(exitSession);
+}
+
+int main(int argc, char **argv)
 {
-    MainMenu();
-    FreeAllOwners();
+    int firstScript = ParseArguments(argc, argv);
+    if (firstScript == 0)
+        return 1;
+    InitSpeciesTable();
+    if (serveSocket != NULL)
+        return RunServer(serveSocket, workerThreads);
+    if (loadSocket != NULL)
+        return RunLoad(loadSocket, workerThreads > 0 ? workerThreads : 4, LOAD_REQUESTS);
+    if (snapshotFile != NULL && !MapSnapshot(&mappedSnapshot, snapshotFile)) //every session reads this one mapping
+        return 1;
+    if (firstScript < argc) { //runner: one session per script, replayed on a thread pool
+        int failed = RunSessions(argv + firstScript, argc - firstScript, workerThreads);
+        UnmapSnapshot(&mappedSnapshot);
+        return failed == 0 ? 0 : 1;
+    }
+    static OwnerRegistry registry;
+    static Session session; //static: FlushAtExit may still look at it after main returns
+    InitRegistry(&registry);
+    InitSession(&session, &registry, STDIN_FILENO, STDOUT_FILENO);
+    session.output.interactive = isatty(STDIN_FILENO);
+    exitSession = &session;
+    atexit(FlushAtExit); //also covers the exit(1) paths
+    if (journalFile != NULL && !OpenJournal(&session, journalFile))
+        return 1;
+    RunSession(&session);
+    UnmapSnapshot(&mappedSnapshot);
     return 0;
 }
 
-void OpenPokedexMenu(void) {
-    printf("Your name: ");
-    char *name = getDynamicInput();
-    if (ownerHead == NULL) {
-        //add data to root of binary tree
-        //HOW? i have an array of pokemon data so i need to add pokemondata[] to data struct.
-        ownerHead = CreateOwnerNode(name);
-        printf("New Pokedex created for %s with starter %s.\n",ownerHead->ownerName, ownerHead->pokedexRoot->data->name);
-    }
-    else { //same thing but when linked list is not empty
-        AddOwner(name);
+void OpenPokedexMenu(Session *session) {
+    OutPrompt(session, "Your name: ");
+    char *name = getDynamicInput(session); //view into the input, CreateOwnerNode makes the only copy
+    if (FindOwnerByName(session, name) != NULL) {
+        OutPrintf(session, "Owner '%s' already exists. Not creating a new Pokedex.\n", name);
+        return;
     }
-    free(name);
+    OwnerNode *owner = CreateOwnerNode(session, name); //copied before the starter prompt reads over it
+    AddOwner(session, owner); //listed before the prompt so it's freed with the rest if the input ends there
+    int starter = StarterPokemon(session);
+    PokedexInsert(session, owner, starter);
+    JournalLog(session, JOURNAL_NEW, starter, owner->ownerName, NULL);
+    OutPrintf(session, "New Pokedex created for %s with starter %s.\n", owner->ownerName, FirstOwned(owner)->name);
 }
 
-OwnerNode *CreateOwnerNode(char *ownerName) {
-    OwnerNode *owner = (OwnerNode *)malloc(sizeof(OwnerNode));
-    if (owner == NULL) {
-        printf("Memory allocation failed.\n");
-        exit(1);
+OwnerNode *NewOwner(Session *session, const char *name, int starterId) {
+    if (FindOwnerByName(session, name) != NULL) {
+        OutPrintf(session, "Owner '%s' already exists. Not creating a new Pokedex.\n", name);
+        return NULL;
     }
+    OwnerNode *owner = CreateOwnerNode(session, name);
+    PokedexInsert(session, owner, starterId);
+    AddOwner(session, owner);
+    JournalLog(session, JOURNAL_NEW, starterId, name, NULL);
+    OutPrintf(session, "New Pokedex created for %s with starter %s.\n", owner->ownerName, FirstOwned(owner)->name);
+    return owner;
+}
+
+OwnerNode *CreateOwnerNode(Session *session, const char *ownerName) {
+    OwnerNode *owner = AllocOwnerNode(session); //from the owner slabs
     owner->next = owner;
     owner->prev = owner;
     owner->ownerName = myStrdup(ownerName);
-    owner->pokedexRoot = StarterPokemon();
+    owner->arena.blocks = owner->arena.last = NULL; //empty arena, first node opens a block
+    owner->arena.freeList = owner->arena.freeTail = NULL;
+    owner->pokedexRoot = NULL;
+    CompactInit(&owner->compact);
+    memset(owner->owned, 0, sizeof(owner->owned));
+    owner->shared = 0; //own arena until it gets cloned
     return owner;
 }
 
-void AddOwner(char *ownerName) {//same thing but when linked list is not empty
-    OwnerNode *current = ownerHead;
-        //going to the end of linked list
-    if (FindOwnerByName(ownerName) != NULL) {
-        printf("Owner '%s' already exists. Not creating a new Pokedex.\n", ownerName);
+void AddOwner(Session *session, OwnerNode *owner) {
+    IndexOwner(session, owner);
+    if (session->registry->ownerHead == NULL) {
+        //add data to root of binary tree
+        //HOW? i have an array of pokemon data so i need to add pokemondata[] to data struct.
+        session->registry->ownerHead = owner;
+        DirectoryAppend(session, owner);
         return;
     }
-    OwnerNode *owner = CreateOwnerNode(ownerName);
-    current = ownerHead;
-     while (current->next != ownerHead)
-         current = current->next; //find the last one in the list
+    //same thing but when linked list is not empty
+    OwnerNode *current = DirectoryTail(session); //the last one in the list, no walking
+    DirectoryAppend(session, owner);
      owner->prev = current; //previous becomes current
-     owner->next = ownerHead; //next becomes pointer to the first one
+     owner->next = session->registry->ownerHead; //next becomes pointer to the first one
      current->next = owner; //next to current becomes pointer to the current one
-     ownerHead->prev = owner; //previous to the pointer to head becomes pointer to the added owner
-    printf("New Pokedex created for %s with starter %s.\n",owner->ownerName, owner->pokedexRoot->data->name);
+     session->registry->ownerHead->prev = owner; //previous to the pointer to head becomes pointer to the added owner
 } //make adding to list if there is no same owners
 
-PokemonNode *StarterPokemon() {
+int StarterId(int choice) {
+    switch (choice) {
+        case 1:
+            return pokedex[0].id;
+        case 2:
+            return pokedex[3].id;
+        case 3:
+            return pokedex[6].id;
+        default:
+            return 0;
+    }
+}
+
+int StarterPokemon(Session *session) {
     int choice;
-    printf("Choose Starter:\n\
+    OutPrompt(session, "Choose Starter:\n\
                 1. Bulbasaur\n\
                 2. Charmander\n\
                 3. Squirtle\n");
-    choice = readIntSafe("Your choice: ");
-    switch (choice) {
-        case 1: {
-            return CreatePokemonNode(&pokedex[0]);
+    choice = readIntSafe(session, "Your choice: ");
+    if (StarterId(choice) != 0)
+        return StarterId(choice);
+    OutStr(session, "Invalid choice.\n");
+    return StarterPokemon(session); //recursion supremacy
+}
+
+PokemonNode *CreatePokemonNode(Session *session, PokemonArena *arena, const PokemonData *data) {
+    PokemonNode *node = ArenaAllocNode(session, arena);
+    node->data = (PokemonData*) data;
+    node->left = node->right = NULL;//right and left nodes == NULL because it's the first one in tree
+    node->height = 1; //new nodes are always leaves
+    node->refs = 1; //just its parent (or the owner)
+    return node;
+}
+
+PokemonNode *ArenaAllocNode(Session *session, PokemonArena *arena) {
+    if (arena->freeList != NULL) { //recycled node first
+        PokemonNode *node = arena->freeList;
+        arena->freeList = node->left;
+        if (arena->freeList == NULL)
+            arena->freeTail = NULL;
+        return node;
+    }
+    if (arena->blocks == NULL || arena->blocks->used == ARENA_BLOCK_NODES) { //need a new block
+        MemoryPools *pools = &session->registry->memoryPools;
+        pthread_mutex_lock(&pools->spareLock); //once per block, not per node
+        PokemonBlock *block = pools->spareBlocks;
+        if (block != NULL) //some deleted pokedex left one behind
+            pools->spareBlocks = block->next;
+        pthread_mutex_unlock(&pools->spareLock);
+        if (block == NULL) {
+            block = (PokemonBlock *)malloc(sizeof(PokemonBlock));
+            if (block == NULL) {
+                OutStr(session, "Memory allocation failed.\n");
+                exit(1);
+            }
+        }
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        if (arena->last == NULL)
+            arena->last = block;
+    }
+    return &arena->blocks->nodes[arena->blocks->used++]; //pointer bump
+}
+
+void ArenaFreeNode(PokemonArena *arena, PokemonNode *node) {
+    node->left = arena->freeList; //left doubles as the free list link
+    if (arena->freeList == NULL)
+        arena->freeTail = node;
+    arena->freeList = node;
+}
+
+void ReleaseArena(Session *session, PokemonArena *arena) {
+    if (arena->blocks != NULL) { //whole chain goes to the spare list at once
+        arena->last->next = session->registry->memoryPools.spareBlocks;
+        session->registry->memoryPools.spareBlocks = arena->blocks;
+    }
+    arena->blocks = arena->last = NULL;
+    arena->freeList = arena->freeTail = NULL;
+}
+
+void SpliceArena(PokemonArena *into, PokemonArena *from) {
+    if (from->blocks != NULL) { //from's chain goes after into's chain, bumping keeps going in into's front block
+        if (into->blocks == NULL) {
+            into->blocks = from->blocks;
         }
-        case 2: {
-            return CreatePokemonNode(&pokedex[3]);
+        else {
+            into->last->next = from->blocks;
         }
-        case 3: {
-            return CreatePokemonNode(&pokedex[6]);
+        into->last = from->last;
+    }
+    if (from->freeList != NULL) { //free lists get glued together too, from's goes in front
+        from->freeTail->left = into->freeList;
+        if (into->freeList == NULL)
+            into->freeTail = from->freeTail;
+        into->freeList = from->freeList;
+    }
+    from->blocks = from->last = NULL;
+    from->freeList = from->freeTail = NULL;
+}
+
+OwnerNode *AllocOwnerNode(Session *session) {
+    MemoryPools *pools = &session->registry->memoryPools;
+    if (pools->freeOwners != NULL) {
+        OwnerNode *owner = pools->freeOwners;
+        pools->freeOwners = owner->next;
+        return owner;
+    }
+    OwnerBlock *block = pools->ownerBlocks;
+    if (block == NULL || block->used == OWNER_BLOCK_SIZE) {
+        block = (OwnerBlock *)malloc(sizeof(OwnerBlock));
+        if (block == NULL) {
+            OutStr(session, "Memory allocation failed.\n");
+            exit(1);
         }
-        default:
-            printf("Invalid choice.\n");
-            return StarterPokemon();
-    } //recursion supremacy
+        block->used = 0;
+        block->next = pools->ownerBlocks;
+        pools->ownerBlocks = block;
+    }
+    return &block->owners[block->used++];
 }
 
-PokemonNode *CreatePokemonNode(const PokemonData *data) {
-    PokemonNode *node = (PokemonNode *)malloc(sizeof(PokemonNode));
-    if (node == NULL) {
-        printf("Memory allocation failed.\n");
+void RecycleOwnerNode(Session *session, OwnerNode *owner) {
+    owner->next = session->registry->memoryPools.freeOwners;
+    session->registry->memoryPools.freeOwners = owner;
+}
+
+void DestroyOwner(Session *session, OwnerNode *owner) {
+    if (owner->shared) { //only the nodes nobody else points at go back
+        pthread_mutex_lock(&session->registry->memoryPools.sharedLock);
+        ReleaseTree(session, owner->pokedexRoot);
+        pthread_mutex_unlock(&session->registry->memoryPools.sharedLock);
+    }
+    ReleaseArena(session, &owner->arena); //the whole pokedex in one go
+    owner->pokedexRoot = NULL;
+    CompactFree(&owner->compact);
+    free(owner->ownerName);
+    owner->ownerName = NULL;
+    RecycleOwnerNode(session, owner);
+}
+
+void FreeMemoryPools(Session *session) {
+    MemoryPools *pools = &session->registry->memoryPools;
+    while (pools->spareBlocks != NULL) {
+        PokemonBlock *block = pools->spareBlocks;
+        pools->spareBlocks = block->next;
+        free(block);
+    }
+    while (pools->ownerBlocks != NULL) {
+        OwnerBlock *block = pools->ownerBlocks;
+        pools->ownerBlocks = block->next;
+        free(block);
+    }
+    pools->freeOwners = NULL;
+}
+
+OwnerNode *ListLookUp(Session *session, int choice) { //looking for a specific person in list and returning their name
+    return DirectoryAt(session, choice);
+}
+
+void CompactDirectory(Session *session, int capacity) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    OwnerNode **slots = (OwnerNode **)malloc((size_t)(capacity + 1) * sizeof(OwnerNode *));
+    int *tree = (int *)malloc((size_t)(capacity + 1) * sizeof(int));
+    if (slots == NULL || tree == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
         exit(1);
     }
-    node->data = (PokemonData*) data;
-    node->left = node->right = NULL;//right and left nodes == NULL because it's the first one in tree
-    return node;
+    int used = 0;
+    for (int i = 1; i <= directory->used; i++) { //live owners only, same order
+        if (directory->slots[i] == NULL)
+            continue;
+        slots[++used] = directory->slots[i];
+        slots[used]->slot = used;
+    }
+    for (int i = 1; i <= used; i++) //every slot alive => tree[i] is just the size of its range
+        tree[i] = i & -i;
+    free(directory->slots);
+    free(directory->tree);
+    directory->slots = slots;
+    directory->tree = tree;
+    directory->used = used;
+    directory->count = used;
+    directory->capacity = capacity;
 }
 
-OwnerNode *ListLookUp(int choice) { //looking for a specific person in list and returning their name
-    OwnerNode *current = ownerHead;
-    int count = 1;
-    do {
-        if (count == choice)
-            break;
-        current = current->next;
-        count++;
-    } while (current->next != ownerHead);
-    return current;
+void DirectoryAppend(Session *session, OwnerNode *owner) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    if (directory->used == directory->capacity) {
+        int capacity = directory->capacity;
+        if (directory->count * 2 >= capacity) //mostly alive => grow, otherwise compacting is enough
+            capacity = capacity == 0 ? OWNER_BLOCK_SIZE : capacity * 2;
+        CompactDirectory(session, capacity);
+    }
+    int slot = ++directory->used;
+    directory->slots[slot] = owner;
+    owner->slot = slot;
+    //tree[slot] covers (slot - lowbit, slot]: everything before slot is known, so sum it up
+    int sum = 1;
+    for (int i = slot - 1; i > slot - (slot & -slot); i -= i & -i)
+        sum += directory->tree[i];
+    directory->tree[slot] = sum;
+    directory->count++;
 }
 
-void AddPokemon(OwnerNode *owner) {
-    int pokemonId;
-    printf("Enter ID to add: ");
-    pokemonId = readIntSafe("");
-    if (pokemonId < 1|| pokemonId > 151) {
-        printf("Invalid ID.\n");
+void DirectoryRemove(Session *session, OwnerNode *owner) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    int slot = owner->slot;
+    if (slot < 1 || slot > directory->used || directory->slots[slot] != owner)
+        return; //not in the directory
+    directory->slots[slot] = NULL;
+    for (int i = slot; i <= directory->used; i += i & -i)
+        directory->tree[i]--;
+    directory->count--;
+    owner->slot = -1;
+    if (directory->count == 0) { //empty => start over
+        directory->used = 0;
         return;
     }
+    while (directory->slots[directory->used] == NULL) //keep the tail slot alive so DirectoryTail stays O(1)
+        directory->used--;
+    if (directory->used > 2 * directory->count + OWNER_BLOCK_SIZE) //too many holes
+        CompactDirectory(session, directory->capacity);
+}
+
+OwnerNode *DirectoryAt(Session *session, int k) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    if (k < 1 || k > directory->count)
+        return NULL;
+    int position = 0;
+    int step = 1;
+    while (step * 2 <= directory->used)
+        step *= 2;
+    for (; step > 0; step /= 2) { //Fenwick descent: biggest jumps that still leave k owners ahead
+        if (position + step <= directory->used && directory->tree[position + step] < k) {
+            position += step;
+            k -= directory->tree[position];
+        }
+    }
+    return directory->slots[position + 1];
+}
+
+OwnerNode *DirectoryTail(Session *session) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    if (directory->count == 0)
+        return NULL;
+    return directory->slots[directory->used];
+}
+
+int OwnerCount(Session *session) {
+    return session->registry->ownerDirectory.count;
+}
+
+void PrintOwnerList(Session *session) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    int number = 1;
+    for (int i = 1; i <= directory->used; i++) {
+        if (directory->slots[i] != NULL) { //"1. name"
+            OutInt(session, number++);
+            OutStr(session, ". ");
+            OutStr(session, directory->slots[i]->ownerName);
+            OutChar(session, '\n');
+        }
+    }
+}
+
+void FreeOwnerDirectory(Session *session) {
+    OwnerDirectory *directory = &session->registry->ownerDirectory;
+    free(directory->slots);
+    free(directory->tree);
+    directory->slots = NULL;
+    directory->tree = NULL;
+    directory->used = directory->count = directory->capacity = 0;
+}
+
+void AddPokemon(Session *session, OwnerNode *owner) {
+    int pokemonId;
+    OutPrompt(session, "Enter ID to add: ");
+    pokemonId = readIntSafe(session, "");
+    AddPokemonId(session, owner, pokemonId);
+}
+
+int AddPokemonId(Session *session, OwnerNode *owner, int pokemonId) {
+    if (pokemonId < 1|| pokemonId > POKEDEX_SIZE) {
+        OutStr(session, "Invalid ID.\n");
+        return 0;
+    }
+    if (OwnerHasPokemon(owner, pokemonId)) { //bitmap says duplicate, no need to walk the tree
+        OutPrintf(session, "Pokemon with ID %d is already in the Pokedex. No changes made.\n", pokemonId);
+        return 0;
+    }
     //printf("Current Node ID: %d, Inserting Pokemon ID: %d\n", owner->pokedexRoot->data->id, pokemonId);
-    owner->pokedexRoot = InsertPokemonNode(owner->pokedexRoot, pokemonId, 0);
+    PokedexInsert(session, owner, pokemonId);
+    JournalLog(session, JOURNAL_ADD, pokemonId, owner->ownerName, NULL);
+    OutPrintf(session, "Pokemon %s (ID %d) added.\n", pokedex[pokemonId - 1].name, pokemonId);
     //printf("Pokemon %s (ID %d) added.\n", owner->pokedexRoot->data->name, pokemonId);
+    return 1;
 }
 
-PokemonNode *InsertPokemonNode(PokemonNode *newNode, int pokemonId, int subChoice) {
+PokemonNode *InsertPokemonNode(Session *session, PokemonArena *arena, PokemonNode *newNode, int pokemonId, int subChoice) {
     if (newNode == NULL) {
         //if tree empty return node
         // printf("Tree is empty. Creating new node for Pokemon ID: %d\n", pokemonId);
         // printf("Pokemon ID %d added to the Pokedex.\n", pokemonId);
-        PokemonNode *node = CreatePokemonNode(&pokedex[pokemonId - 1]);
+        PokemonNode *node = CreatePokemonNode(session, arena, &pokedex[pokemonId - 1]);
         if (subChoice == 1) //just that printf won't get printed when i'm doing evolving
             return node;
-        printf("Pokemon %s (ID %d) added.\n", node->data->name, pokemonId);
+        OutPrintf(session, "Pokemon %s (ID %d) added.\n", node->data->name, pokemonId);
         return node;
     }
     // else {
@@ -477,279 +1184,314 @@ PokemonNode *InsertPokemonNode(PokemonNode *newNode, int pokemonId, int subChoic
         //base case if the node is present then return it
         if (subChoice == 1) //for when evolving to not print message
             return newNode;
-        printf("Pokemon with ID %d is already in the Pokedex. No changes made.\n", pokemonId);
+        OutPrintf(session, "Pokemon with ID %d is already in the Pokedex. No changes made.\n", pokemonId);
         return newNode;
     }
     if (newNode->data->id < pokedex[pokemonId - 1].id) {
         //if the id is bigger then right node
        // printf("Going right from Node ID: %d\n", newNode->data->id);
-        newNode->right = InsertPokemonNode(newNode->right, pokemonId, subChoice);
+        newNode->right = InsertPokemonNode(session, arena, newNode->right, pokemonId, subChoice);
     }
     else if (newNode->data->id > pokedex[pokemonId - 1].id) {
         //if id is smaller then left node
         //printf("Going left from Node ID: %d\n", newNode->data->id);
-        newNode->left = InsertPokemonNode(newNode->left, pokemonId, subChoice);
+        newNode->left = InsertPokemonNode(session, arena, newNode->left, pokemonId, subChoice);
     }
-    return newNode;
+    return RebalanceNode(newNode); //fixing the path back to the root so ascending inserts don't make a list
 }
 
-Queue *CreateQueue() {
-    Queue *queue = (Queue *)malloc(sizeof(Queue));
-    if (queue == NULL) {
-        printf("Memory allocation failed.\n");
-        exit(1);
-    }
-    queue->front = queue->rear = NULL;
-    return queue;
+int NodeHeight(PokemonNode *node) {
+    if (node == NULL)
+        return 0;
+    return node->height;
 }
 
-void Enqueue(Queue *queue, PokemonNode *node) { //function to add elements to queue list
-    QueueNode *newNode = (QueueNode *)malloc(sizeof(QueueNode));
-    if (newNode == NULL) {
-        printf("Memory allocation failed.\n");
-        exit(1);
-    }
-    newNode->node = node; //adding pointer of the tree to queue
-    newNode->next = NULL; //next element in queue is NULL
-    if (queue->front == NULL) { //if last element of the queue is NULL means that queue is empty and pointer to the first element is the same as last one
-        queue->front = queue->rear = newNode;
-        return;
-    }
-    //else if queue is not empty i need to add next element to the next after last because first in first out !
-    queue->rear->next = newNode;
-    queue->rear = newNode; //updating the last element of the queue
+void UpdateHeight(PokemonNode *node) {
+    int left = NodeHeight(node->left);
+    int right = NodeHeight(node->right);
+    node->height = (left > right ? left : right) + 1;
+}
+
+PokemonNode *RotateLeft(PokemonNode *node) {
+    PokemonNode *pivot = node->right; //right child goes up
+    node->right = pivot->left;
+    pivot->left = node;
+    UpdateHeight(node); //node is below pivot now so it goes first
+    UpdateHeight(pivot);
+    return pivot;
 }
 
-PokemonNode *Dequeue(Queue *queue) {
-    if (queue->front == NULL) {
+PokemonNode *RotateRight(PokemonNode *node) {
+    PokemonNode *pivot = node->left; //left child goes up
+    node->left = pivot->right;
+    pivot->right = node;
+    UpdateHeight(node);
+    UpdateHeight(pivot);
+    return pivot;
+}
+
+PokemonNode *RebalanceNode(PokemonNode *node) {
+    if (node == NULL)
         return NULL;
-    }//i need to do it first in first out
-    QueueNode *temp = queue->front;
-    PokemonNode *node = temp->node;
-    queue->front = queue->front->next; //first in first out babyyyy
-    if (queue->front == NULL)
-        queue->rear = NULL; //if queue is empty
-    free(temp);
+    UpdateHeight(node);
+    int balance = NodeHeight(node->left) - NodeHeight(node->right);
+    if (balance > 1) { //left heavy
+        if (NodeHeight(node->left->left) < NodeHeight(node->left->right))
+            node->left = RotateLeft(node->left); //left-right case
+        return RotateRight(node);
+    }
+    if (balance < -1) { //right heavy
+        if (NodeHeight(node->right->right) < NodeHeight(node->right->left))
+            node->right = RotateRight(node->right); //right-left case
+        return RotateLeft(node);
+    }
     return node;
 }
 
-void BFSGeneric(PokemonNode *root, VisitNodeFunc visit) {
+void CursorInit(TreeCursor *cursor, PokemonNode *root, TraversalOrder order) {
+    cursor->order = order;
+    cursor->head = cursor->top = 0;
+    cursor->current = NULL;
+    cursor->lastVisited = NULL;
     if (root == NULL)
         return;
-    Queue *queue = CreateQueue();//creating queue
-    Enqueue(queue, root);//adding root to queue
-    while (queue->front != NULL) {
-        PokemonNode *node = Dequeue(queue); //deleting from queue
-        visit(node);
+    if (order == ORDER_IN || order == ORDER_POST)
+        cursor->current = root; //these two go down the left side lazily
+    else
+        cursor->items[cursor->top++] = root; //bfs queue / pre-order stack starts with the root
+}
+
+PokemonNode *CursorNext(TreeCursor *cursor) {
+    PokemonNode *node;
+    switch (cursor->order) {
+    case ORDER_BFS:
+        if (cursor->head == cursor->top)
+            return NULL;
+        node = cursor->items[cursor->head++]; //first in first out
         if (node->left != NULL)
-            Enqueue(queue, node->left);
+            cursor->items[cursor->top++] = node->left;
         if (node->right != NULL)
-            Enqueue(queue, node->right);
+            cursor->items[cursor->top++] = node->right;
+        return node;
+    case ORDER_PRE:
+        if (cursor->top == 0)
+            return NULL;
+        node = cursor->items[--cursor->top];
+        if (node->right != NULL) //right goes in first so left comes out first
+            cursor->items[cursor->top++] = node->right;
+        if (node->left != NULL)
+            cursor->items[cursor->top++] = node->left;
+        return node;
+    case ORDER_IN:
+        while (cursor->current != NULL) { //all the way left, remembering the path
+            cursor->items[cursor->top++] = cursor->current;
+            cursor->current = cursor->current->left;
+        }
+        if (cursor->top == 0)
+            return NULL;
+        node = cursor->items[--cursor->top];
+        cursor->current = node->right; //next time: the leftmost of the right subtree
+        return node;
+    case ORDER_POST:
+        while (cursor->current != NULL || cursor->top > 0) {
+            if (cursor->current != NULL) {
+                cursor->items[cursor->top++] = cursor->current;
+                cursor->current = cursor->current->left;
+                continue;
+            }
+            node = cursor->items[cursor->top - 1];
+            if (node->right != NULL && cursor->lastVisited != node->right) {
+                cursor->current = node->right; //right side not done yet
+                continue;
+            }
+            cursor->top--; //both sides done => now it's this one's turn
+            cursor->lastVisited = node;
+            return node;
+        }
+        return NULL;
     }
-    free(queue);
+    return NULL;
 }
 
-void DisplayBFS(PokemonNode *root) {
-    BFSGeneric(root, PrintPokemon);
+PokemonNode *TraverseTree(PokemonNode *root, TraversalOrder order, VisitNodeCtxFunc visit, void *context) {
+    TreeCursor cursor;
+    CursorInit(&cursor, root, order);
+    PokemonNode *node;
+    while ((node = CursorNext(&cursor)) != NULL) {
+        if (visit(node, context))
+            return node; //visitor said stop
+    }
+    return NULL;
 }
 
-void preOrderGeneric(PokemonNode *root, VisitNodeFunc visit) {
-    if (root == NULL)
-        return;
-    visit(root);
-    preOrderGeneric(root->left, visit);
-    preOrderGeneric(root->right, visit);
+//walks every node with a plain VisitNodeFunc, for the *Generic wrappers below
+static void VisitAll(Session *session, PokemonNode *root, TraversalOrder order, VisitNodeFunc visit) {
+    TreeCursor cursor;
+    CursorInit(&cursor, root, order);
+    PokemonNode *node;
+    while ((node = CursorNext(&cursor)) != NULL)
+        visit(session, node);
 }
 
-void PreOrderTraversal(PokemonNode *root) {
-    preOrderGeneric(root, PrintPokemon);
+void BFSGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit) {
+    VisitAll(session, root, ORDER_BFS, visit);
 }
 
-void inOrderGeneric(PokemonNode *root, VisitNodeFunc visit) {
-    if (root == NULL)
-        return;
-    inOrderGeneric(root->left, visit);
-    visit(root);
-    inOrderGeneric(root->right, visit);
+void DisplayBFS(Session *session, PokemonNode *root) {
+    BFSGeneric(session, root, PrintPokemon);
 }
 
-void InOrderTraversal(PokemonNode *root) {
-    inOrderGeneric(root, PrintPokemon);
+void preOrderGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit) {
+    VisitAll(session, root, ORDER_PRE, visit);
 }
 
-void postOrderGeneric(PokemonNode *root, VisitNodeFunc visit) {
-    if (root == NULL)
-        return;
-    postOrderGeneric(root->left, visit);
-    postOrderGeneric(root->right, visit);
-    visit(root);
+void PreOrderTraversal(Session *session, PokemonNode *root) {
+    preOrderGeneric(session, root, PrintPokemon);
 }
 
-void PostOrderTraversal(PokemonNode *root) {
-    postOrderGeneric(root, PrintPokemon);
+void inOrderGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit) {
+    VisitAll(session, root, ORDER_IN, visit);
 }
 
-void DisplayAlphabetical(PokemonNode *root) {
-    NodeArray pokemons;
-    InitNodeArray(&pokemons, 1);
-    //printf("Adding Pokemon ID: %d, Name: %s to NodeArray.\n", root->data->id, root->data->name);
-    CollectAll(root, &pokemons);
-    //qsort(pokemons.nodes, pokemons.size, sizeof(PokemonNode*), CompareByNameNode);
-    QuickSort(&pokemons, 0, pokemons.size - 1);
-    for (int i = 0; i < pokemons.size; i++) {
-        PrintPokemon(pokemons.nodes[i]);
-    }
-    FreeNodeArray(&pokemons);
+void InOrderTraversal(Session *session, PokemonNode *root) {
+    inOrderGeneric(session, root, PrintPokemon);
 }
 
-int Partition(NodeArray *pokemons, int low, int high) {
-    PokemonNode *pivot = pokemons->nodes[low];//pivot the last element of the array
-    int i = low; //i = 0
-    int j = high; //j = num of last element
-    while (i < j) {
-        //printf("Pokemon name %s\n", pokemons->nodes[i]->data->name);
-       // printf("Pivot name %s\n", pivot->data->name);
-        while (CompareByNameNode(&pokemons->nodes[i], &pivot) <= 0 && i < high) {
-            i++; //compare node i and last element till i last el before previous
-        }
-        while (CompareByNameNode(&pokemons->nodes[j], &pivot) > 0 && j > low) {
-            j--; //compare node j and last element till j larger then 2 el in array
-        }
-        if (i < j) {
-            //printf("Swapping %s and %s\n", pokemons->nodes[i]->data->name, pokemons->nodes[j]->data->name);
-            Swap(&pokemons->nodes[i], &pokemons->nodes[j]);
-        }
-    }
-    //printf("Swapping %s and %s\n", pokemons->nodes[low]->data->name, pokemons->nodes[j]->data->name);
-    Swap(&pokemons->nodes[low], &pokemons->nodes[j]);
-    return j;
+void postOrderGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit) {
+    VisitAll(session, root, ORDER_POST, visit);
 }
 
-void Swap(PokemonNode **a, PokemonNode **b) {
-    PokemonNode *temp = *a;
-    *a = *b;
-    *b = temp;
+void PostOrderTraversal(Session *session, PokemonNode *root) {
+    postOrderGeneric(session, root, PrintPokemon);
 }
 
-void QuickSort(NodeArray *pokemons, int low, int high) {
-    if (low < high) {
-        int pivot = Partition(pokemons, low, high);
-        QuickSort(pokemons, low, pivot - 1);
-        QuickSort(pokemons, pivot + 1, high);
+void DisplayPokedex(Session *session, OwnerNode *owner, TraversalOrder order) {
+    if (pokedexLayout == LAYOUT_COMPACT) {
+        CompactDisplay(session, &owner->compact, order);
+        return;
     }
-}
-
-void InitNodeArray(NodeArray *na, int cap) {
-    na->nodes = malloc(cap * sizeof(PokemonNode *)); //initializing array inside of struct
-    if (na->nodes == NULL) {
-        printf("Memory allocation failed.\n");
-        exit(1);
+    switch (order) {
+    case ORDER_BFS:
+        DisplayBFS(session, owner->pokedexRoot);
+        break;
+    case ORDER_PRE:
+        PreOrderTraversal(session, owner->pokedexRoot);
+        break;
+    case ORDER_IN:
+        InOrderTraversal(session, owner->pokedexRoot);
+        break;
+    case ORDER_POST:
+        PostOrderTraversal(session, owner->pokedexRoot);
+        break;
     }
-    na->size = 0;
-    na->capacity = cap;
 }
 
-void FreeNodeArray(NodeArray *na) {
-    //printf("Freeing NodeArray with size: %d and capacity: %d\n", na->size, na->capacity);
-    free(na->nodes);
-    na->nodes = NULL;
-    na->size = 0;
+void DisplayPokedexAlphabetical(Session *session, const OwnerNode *owner) {
+    if (pokedexLayout == LAYOUT_COMPACT)
+        CompactDisplayAlphabetical(session, &owner->compact);
+    else
+        DisplayAlphabetical(session, owner->pokedexRoot);
 }
 
-void AddNode(NodeArray *na, PokemonNode *node) { //i'm very not sure in my doings here
-    if (na->size >= na->capacity) {
-        na->capacity *= 2;
-        na->nodes = realloc(na->nodes, na->capacity * sizeof(PokemonNode *));
-        if (na->nodes == NULL) {
-            printf("Memory allocation failed.\n");
-            exit(1);
-        }
+void DisplayAlphabetical(Session *session, PokemonNode *root) {
+    PokemonNode *slots[POKEDEX_SIZE] = {NULL}; //one slot per species, already in name order
+    CollectByRank(root, slots);
+    for (int i = 0; i < POKEDEX_SIZE; i++) {
+        if (slots[i] != NULL)
+            PrintPokemon(session, slots[i]);
     }
-    na->nodes[na->size] = node; //adding first element to my array in struct
-    na->size++;//size increase
 }
 
-void CollectAll(PokemonNode *root, NodeArray *na) { //bro i'm trying to destroy these data structures it just happens that they somehow end up working
-    if (root == NULL) //base case
-        return;
-   // printf("Adding Pokemon ID: %d, Name: %s to NodeArray.\n", root->data->id, root->data->name);
-    AddNode(na, root);
-   // printf("Traversing left from Pokemon ID: %d, Name: %s\n", root->data->id, root->data->name);
-    CollectAll(root->left, na);
-    //printf("Traversing right from Pokemon ID: %d, Name: %s\n", root->data->id, root->data->name);
-    CollectAll(root->right, na);
+void CollectByRank(PokemonNode *root, PokemonNode **slots) {
+    TreeCursor cursor;
+    CursorInit(&cursor, root, ORDER_PRE);
+    PokemonNode *node;
+    while ((node = CursorNext(&cursor)) != NULL)
+        slots[pokedexAlphaRank[node->data->id]] = node; //counting sort with counts of 0 or 1
 }
 
-int CompareByNameNode(const void *a, const void *b) { //how the fuck do i implement qsort here?
-    PokemonNode *NodeA = *(PokemonNode **)a;
-    PokemonNode *NodeB = *(PokemonNode **)b;
-    return strcmp(NodeA->data->name, NodeB->data->name);
-}
 // Function to print a single Pokemon node
-void PrintPokemon(PokemonNode *root) {
-    printf("ID: %d, ", root->data->id);
-    printf("Name: %s, ", root->data->name);
-    printf("Type: %s, ", getTypeName(root->data->TYPE));
-    printf("HP: %d, ", root->data->hp);
-    printf("Attack: %d, ", root->data->attack);
-    if (root->data->CAN_EVOLVE == 0)
-        printf("Can Evolve: No\n");
+void PrintPokemon(Session *session, PokemonNode *root) {
+    PrintPokemonData(session, root->data);
+}
+
+void PrintPokemonData(Session *session, const PokemonData *data) {
+    OutStr(session, "ID: ");
+    OutInt(session, data->id);
+    OutStr(session, ", Name: ");
+    OutStr(session, data->name);
+    OutStr(session, ", Type: ");
+    OutStr(session, getTypeName(data->TYPE));
+    OutStr(session, ", HP: ");
+    OutInt(session, data->hp);
+    OutStr(session, ", Attack: ");
+    OutInt(session, data->attack);
+    OutStr(session, ", ");
+    if (data->CAN_EVOLVE == 0)
+        OutStr(session, "Can Evolve: No\n");
     else
-        printf("Can Evolve: Yes\n");
+        OutStr(session, "Can Evolve: Yes\n");
 }
 
-void FreePokemon(OwnerNode *owner) {
+void FreePokemon(Session *session, OwnerNode *owner) {
     int pokemonId = 0;
-    if (owner->pokedexRoot == NULL) {
-        printf("No Pokemon to release.\n");
+    if (OwnerPokemonCount(owner) == 0) {
+        OutStr(session, "No Pokemon to release.\n");
         return;
     }
-    printf("Enter Pokemon ID to release: ");
-    pokemonId = readIntSafe("");
-    if (pokemonId <= 0 || pokemonId > 151) {
-        printf("Invalid choice.\n");
-        return;
+    OutPrompt(session, "Enter Pokemon ID to release: ");
+    pokemonId = readIntSafe(session, "");
+    ReleasePokemonId(session, owner, pokemonId);
+}
+
+int ReleasePokemonId(Session *session, OwnerNode *owner, int pokemonId) {
+    if (pokemonId <= 0 || pokemonId > POKEDEX_SIZE) {
+        OutStr(session, "Invalid choice.\n");
+        return 0;
     }
-    if (SearchPokemonBFS(owner->pokedexRoot, pokemonId) == NULL) {
-        printf("No Pokemon with ID %d found.\n", pokemonId);
-        return;
+    if (!OwnerHasPokemon(owner, pokemonId)) {
+        OutPrintf(session, "No Pokemon with ID %d found.\n", pokemonId);
+        return 0;
     }
-    printf("Removing Pokemon %s (ID %d).\n", SearchPokemonBFS(owner->pokedexRoot, pokemonId)->data->name, pokemonId);
-    owner->pokedexRoot = ReleasePokemon(owner->pokedexRoot, SearchPokemonBFS(owner->pokedexRoot, pokemonId)->data);
+    PokemonData *data = (PokemonData *)&pokedex[pokemonId - 1]; //every node points into the static table
+    OutPrintf(session, "Removing Pokemon %s (ID %d).\n", data->name, pokemonId);
+    PokedexRemove(session, owner, pokemonId);
+    JournalLog(session, JOURNAL_RELEASE, pokemonId, owner->ownerName, NULL);
+    return 1;
 }
 
-PokemonNode* ReleasePokemon(PokemonNode *root, PokemonData *data) {
+PokemonNode* ReleasePokemon(PokemonArena *arena, PokemonNode *root, PokemonData *data) {
     if (root == NULL) //base case
         return root;
     if (data->id < root->data->id) {//going left
         //printf("Going left: Current Node ID: %d\n", root->data->id);
-        root->left = ReleasePokemon(root->left, data);
+        root->left = ReleasePokemon(arena, root->left, data);
     }
     else if (data->id > root->data->id) {//going right
         //printf("Going right: Current Node ID: %d\n", root->data->id);
-        root->right = ReleasePokemon(root->right, data);
+        root->right = ReleasePokemon(arena, root->right, data);
     } //when the leaf is found
     else { //else if one child
         //printf("Found Pokemon to delete: ID %d, Name: %s\n", root->data->id, root->data->name);
         if (root->left == NULL) {//if there is only right node or 0
             PokemonNode *temp = root->right;
            // printf("Node has no left child. Replacing with right child.\n");
-            free(root);
+            ArenaFreeNode(arena, root);
             return temp;
         }
         if (root->right == NULL) { //if only left node
             PokemonNode *temp = root->left;
            // printf("Node has no right child. Replacing with left child.\n");
-            free(root);
+            ArenaFreeNode(arena, root);
             return temp;
         } //both present
         PokemonNode *temp = FindMax(root); //find maximum in bst
         // printf("Node has two children. Replacing with max from left subtree: ID %d, Name: %s\n",
          //      temp->data->id, temp->data->name);
         root->data = temp->data; //replace everything
-        root->left = ReleasePokemon(root->left, temp->data);
+        root->left = ReleasePokemon(arena, root->left, temp->data);
     }
-    return root;
+    return RebalanceNode(root);
 }
 
 PokemonNode* FindMax(PokemonNode *root) {
@@ -759,361 +1501,3524 @@ PokemonNode* FindMax(PokemonNode *root) {
     return root;
 }
 
-void FreePokemonTree(PokemonNode *root) {
-    if (root == NULL) //base case
-        return;
-    FreePokemonTree(root->left);
-    FreePokemonTree(root->right);
-    free(root);
-}
-
-void FreeOwnerNode(OwnerNode *owner) { //how am i contring if the owner in the middle of the list?
-    OwnerNode *ownerTail = ownerHead; //made two pointers for the same one just for easier logic and reading
+void FreeOwnerNode(Session *session, OwnerNode *owner) { //how am i contring if the owner in the middle of the list?
+    OwnerNode *ownerTail = session->registry->ownerHead; //made two pointers for the same one just for easier logic and reading
     if (owner == NULL)
         return;
-    if (owner == ownerHead) { //if deleteing from start of the list
-        if (owner->next == ownerHead) {
-            FreeHead(owner); //if the only one
+    UnindexOwner(session, owner); //before the name is gone
+    DirectoryRemove(session, owner);
+    if (owner == session->registry->ownerHead) { //if deleteing from start of the list
+        if (owner->next == session->registry->ownerHead) {
+            FreeHead(session); //if the only one
             return;
         }
-        ownerTail = ownerHead->prev; //first one becomes next
-        ownerTail->next = ownerHead->next; //next pointer to first becomes previous ownerhead
-        ownerHead->next->prev = ownerTail; //previous pointer to owner head next is the last one
-        ownerHead = ownerHead->next; //updating ownerhead
+        ownerTail = session->registry->ownerHead->prev; //first one becomes next
+        ownerTail->next = session->registry->ownerHead->next; //next pointer to first becomes previous ownerhead
+        session->registry->ownerHead->next->prev = ownerTail; //previous pointer to owner head next is the last one
+        session->registry->ownerHead = session->registry->ownerHead->next; //updating ownerhead
          // printf("Updated ownerHead: %s\n", ownerHead->ownerName);
          // printf("Updated ownerTail: %s\n", ownerTail->ownerName);
-        FreePokemonTree(owner->pokedexRoot);
-        free(owner->ownerName);
-        free(owner);
+        DestroyOwner(session, owner);
         owner = NULL;
         return;
     }
     if (owner->next == ownerTail) { //if next one is pointer to first then put pointer to head in the current
         ownerTail = owner->prev; //pointer to previous becomes pointer to first
-        ownerTail->next = ownerHead; //new pointer to the head !
-        ownerHead->prev = ownerTail;
-        FreePokemonTree(owner->pokedexRoot);
-        free(owner->ownerName);
-        free(owner);
+        ownerTail->next = session->registry->ownerHead; //new pointer to the head !
+        session->registry->ownerHead->prev = ownerTail;
+        DestroyOwner(session, owner);
         owner = NULL;
         return;
     } //if owner next not last then next becomes next after next
     else {
         owner->prev->next = owner->next; //next after prev becomes next after current
         owner->next->prev = owner->prev; //perv before next becomes prev after current
-        FreePokemonTree(owner->pokedexRoot);
-        free(owner->ownerName);
-        free(owner);
+        DestroyOwner(session, owner);
         owner = NULL;
     }
 }
 
-void FreeHead() {
-    if (ownerHead == NULL)
+void FreeHead(Session *session) {
+    if (session->registry->ownerHead == NULL)
         return;
-    FreePokemonTree(ownerHead->pokedexRoot);
-    free(ownerHead->ownerName);
-    free(ownerHead);
-    ownerHead = NULL;
+    UnindexOwner(session, session->registry->ownerHead); //no-op if FreeOwnerNode already did it
+    DirectoryRemove(session, session->registry->ownerHead);
+    DestroyOwner(session, session->registry->ownerHead);
+    session->registry->ownerHead = NULL;
 }
 
-void DeletePokedex(void) {
-    if (ownerHead == NULL) {
-        printf("No existing Pokedexes to delete.\n");
+void DeletePokedex(Session *session) {
+    if (session->registry->ownerHead == NULL) {
+        OutStr(session, "No existing Pokedexes to delete.\n");
         return;
     }
-    printf("\n=== Delete a Pokedex ===\n");
-    int count = 1;
+    OutPrompt(session, "\n=== Delete a Pokedex ===\n");
+    int count = OwnerCount(session);
     int choice;
-    OwnerNode *node = ownerHead;//first one in the list
-    do { //while the node is not pointer to the first one
-        printf("%d. %s\n", count, node->ownerName);
-        node = node->next; //next one
-        count++;
-    } while (node != ownerHead);
-    printf("Choose a Pokedex to delete by number: ");
-    choice = readIntSafe("");
-    while (choice > count - 1 || choice < 1) {
-        printf("Invalid choice.\n");
-        choice = readIntSafe("");
-    }
-    OwnerNode *current = ListLookUp(choice);
-    printf("Deleting %s's entire Pokedex...\n", current->ownerName);
-    FreeOwnerNode(current);
-    printf("Pokedex deleted.\n");
+    if (!session->output.batch) //the numbered list is part of the menu
+        PrintOwnerList(session);
+    OutPrompt(session, "Choose a Pokedex to delete by number: ");
+    choice = readIntSafe(session, "");
+    while (choice > count || choice < 1) {
+        OutStr(session, "Invalid choice.\n");
+        choice = readIntSafe(session, "");
+    }
+    DeleteOwner(session, ListLookUp(session, choice));
+}
+
+void DeleteOwner(Session *session, OwnerNode *owner) {
+    OutPrintf(session, "Deleting %s's entire Pokedex...\n", owner->ownerName);
+    JournalLog(session, JOURNAL_DELETE, 0, owner->ownerName, NULL);
+    FreeOwnerNode(session, owner);
+    OutStr(session, "Pokedex deleted.\n");
 }
 
 PokemonNode *SearchPokemonBFS(PokemonNode *root, int id) {
-    if (root == NULL)
-        return NULL;
-    Queue *queue = CreateQueue();//creating queue
-    Enqueue(queue, root);//adding root to queue
-    while (queue->front != NULL) {
-        PokemonNode *node = Dequeue(queue);
-        if (node->data->id == id) {
-            while (queue->front != NULL) {
-                Dequeue(queue);
-            }
-            free(queue);
-            return node;
-        }
-        if (node->left != NULL) {
-           // printf("node left id: %d\n", node->left->data->id);
-            Enqueue(queue, node->left);
-        }
-        if (node->right != NULL) {
-           // printf("node right id: %d\n", node->right->data->id);
-            Enqueue(queue, node->right);
-        }
+    return SearchPokemonBST(root, id); //the tree is sorted by ID, no need to queue every node
+}
+
+PokemonNode *SearchPokemonBST(PokemonNode *root, int id) {
+    while (root != NULL) { //just going down, smaller left bigger right
+        if (id < root->data->id)
+            root = root->left;
+        else if (id > root->data->id)
+            root = root->right;
+        else
+            return root;
     }
-    free(queue);
     return NULL;
 }
 
-void PokemonFight(OwnerNode *owner) {
-    if (owner->pokedexRoot == NULL) {
-        printf("Pokedex is empty.\n");
-        return;
+PokemonNode *ResolvePokemon(OwnerNode *owner, int id) {
+    if (!OwnerHasPokemon(owner, id)) //also covers out of range
+        return NULL;
+    return SearchPokemonBST(owner->pokedexRoot, id);
+}
+
+int OwnerHasPokemon(const OwnerNode *owner, int id) {
+    return owner != NULL && OwnedHas(owner->owned, id);
+}
+
+int OwnedHas(const unsigned long long *owned, int id) {
+    if (id < 1 || id > POKEDEX_SIZE)
+        return 0;
+    return (int)((owned[(id - 1) / 64] >> ((id - 1) % 64)) & 1ULL);
+}
+
+void MarkOwned(OwnerNode *owner, int id) {
+    owner->owned[(id - 1) / 64] |= 1ULL << ((id - 1) % 64);
+}
+
+void UnmarkOwned(OwnerNode *owner, int id) {
+    owner->owned[(id - 1) / 64] &= ~(1ULL << ((id - 1) % 64));
+}
+
+int LowestBit(unsigned long long word) {
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while ((word & 1ULL) == 0) {
+        word >>= 1;
+        bit++;
     }
-    int id1, id2;
-    printf("Enter ID of the first Pokemon: ");
-    id1 = readIntSafe("");
-    printf("Enter ID of the second Pokemon: ");
-    id2 = readIntSafe("");
-    if (id1 < 1 || id2 < 1 || id1 > 151 || id2 > 151) {
-        printf("One or both Pokemon IDs not found.\n");
-        return;
+    return bit;
+#endif
+}
+
+int CountBits(unsigned long long word) {
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    int bits = 0;
+    while (word != 0) {
+        word &= word - 1; //drops the lowest set bit
+        bits++;
     }
-    if (SearchPokemonBFS(owner->pokedexRoot, id1) == NULL || SearchPokemonBFS(owner->pokedexRoot, id2) == NULL) {
-        printf("One or both Pokemon IDs not found.\n");
+    return bits;
+#endif
+}
+
+int OwnerPokemonCount(const OwnerNode *owner) {
+    int count = 0;
+    for (int w = 0; w < POKEDEX_WORDS; w++)
+        count += CountBits(owner->owned[w]);
+    return count;
+}
+
+const PokemonData *FirstOwned(const OwnerNode *owner) {
+    int w = 0;
+    while (owner->owned[w] == 0)
+        w++;
+    return &pokedex[w * 64 + LowestBit(owner->owned[w])];
+}
+
+void CompactInit(CompactPokedex *dex) {
+    dex->nodes = NULL;
+    dex->root = COMPACT_NIL;
+    dex->count = dex->capacity = 0;
+}
+
+void CompactFree(CompactPokedex *dex) {
+    free(dex->nodes);
+    CompactInit(dex);
+}
+
+static void CompactReserve(CompactPokedex *dex, int needed) {
+    if (needed <= dex->capacity)
         return;
+    int capacity = dex->capacity == 0 ? COMPACT_MIN_CAPACITY : dex->capacity * 2;
+    while (capacity < needed)
+        capacity *= 2;
+    if (capacity > POKEDEX_SIZE) //can't own more than every species
+        capacity = POKEDEX_SIZE;
+    CompactNode *nodes = realloc(dex->nodes, sizeof(CompactNode) * capacity);
+    if (nodes == NULL) {
+        fputs("Memory allocation failed.\n", stderr); //merges call this from worker threads
+        exit(1);
     }
-    double score1, score2;
-    printf("Pokemon 1: %s ", SearchPokemonBFS(owner->pokedexRoot, id1)->data->name);
-    score1 = SearchPokemonBFS(owner->pokedexRoot, id1)->data->hp * 1.2 + SearchPokemonBFS(owner->pokedexRoot, id1)->data->attack * 1.5;
-    printf("(Score = %.2f)\n", score1);
-    printf("Pokemon 2: %s ", SearchPokemonBFS(owner->pokedexRoot, id2)->data->name);
-    score2 = SearchPokemonBFS(owner->pokedexRoot, id2)->data->hp * 1.2 + SearchPokemonBFS(owner->pokedexRoot, id2)->data->attack * 1.5;
-    printf("(Score = %.2f)\n", score2);
-    if (score1 > score2)
-        printf("%s wins!\n", SearchPokemonBFS(owner->pokedexRoot, id1)->data->name);
-    else if (score2 > score1)
-        printf("%s wins!\n", SearchPokemonBFS(owner->pokedexRoot, id2)->data->name);
-    else
-        printf("It's a tie!\n");
+    dex->nodes = nodes;
+    dex->capacity = capacity;
 }
 
-void EvolvePokemon(OwnerNode *owner) {
-    if (owner->pokedexRoot == NULL) {
-        printf("Cannot evolve. Pokedex empty.\n");
-        return;
+static int CompactHeight(const CompactPokedex *dex, uint32_t node) {
+    return node == COMPACT_NIL ? 0 : dex->nodes[node].height;
+}
+
+static void CompactUpdateHeight(CompactPokedex *dex, uint32_t node) {
+    int left = CompactHeight(dex, dex->nodes[node].left);
+    int right = CompactHeight(dex, dex->nodes[node].right);
+    dex->nodes[node].height = (uint8_t)((left > right ? left : right) + 1);
+}
+
+static uint32_t CompactRotateLeft(CompactPokedex *dex, uint32_t node) {
+    uint32_t pivot = dex->nodes[node].right;
+    dex->nodes[node].right = dex->nodes[pivot].left;
+    dex->nodes[pivot].left = node;
+    CompactUpdateHeight(dex, node);
+    CompactUpdateHeight(dex, pivot);
+    return pivot;
+}
+
+static uint32_t CompactRotateRight(CompactPokedex *dex, uint32_t node) {
+    uint32_t pivot = dex->nodes[node].left;
+    dex->nodes[node].left = dex->nodes[pivot].right;
+    dex->nodes[pivot].right = node;
+    CompactUpdateHeight(dex, node);
+    CompactUpdateHeight(dex, pivot);
+    return pivot;
+}
+
+static uint32_t CompactRebalance(CompactPokedex *dex, uint32_t node) { //same cases as RebalanceNode
+    CompactUpdateHeight(dex, node);
+    CompactNode *n = &dex->nodes[node];
+    int balance = CompactHeight(dex, n->left) - CompactHeight(dex, n->right);
+    if (balance > 1) {
+        if (CompactHeight(dex, dex->nodes[n->left].left) < CompactHeight(dex, dex->nodes[n->left].right))
+            n->left = CompactRotateLeft(dex, n->left);
+        return CompactRotateRight(dex, node);
     }
-    int id;
-    printf("Enter ID of Pokemon to evolve: \n");
-    id = readIntSafe("");
-    if (id < 1 || id > 151) { //id out of bounds
-        printf("No pokemon with ID %d found.\n", id);
-        return;
+    if (balance < -1) {
+        if (CompactHeight(dex, dex->nodes[n->right].right) < CompactHeight(dex, dex->nodes[n->right].left))
+            n->right = CompactRotateRight(dex, n->right);
+        return CompactRotateLeft(dex, node);
     }
-    if (SearchPokemonBFS(owner->pokedexRoot, id) == NULL) { //there is no pokemon in pokedex
-        printf("No pokemon with ID %d found.\n", id);
-        return;
+    return node;
+}
+
+static uint32_t CompactInsertAt(CompactPokedex *dex, uint32_t node, int species) {
+    if (node == COMPACT_NIL) {
+        uint32_t fresh = (uint32_t)dex->count++; //always the end of the array
+        dex->nodes[fresh].species = (uint8_t)species;
+        dex->nodes[fresh].height = 1;
+        dex->nodes[fresh].left = dex->nodes[fresh].right = COMPACT_NIL;
+        return fresh;
     }
-    if (SearchPokemonBFS(owner->pokedexRoot, id)->data->CAN_EVOLVE == CANNOT_EVOLVE) {//pokemon cannot evolve
-        printf("%s (ID %d) cannot evolve.\n", SearchPokemonBFS(owner->pokedexRoot, id)->data->name, id);
-        return;
+    if (species < dex->nodes[node].species) {
+        uint32_t child = CompactInsertAt(dex, dex->nodes[node].left, species);
+        dex->nodes[node].left = child;
     }
-    if (SearchPokemonBFS(owner->pokedexRoot, id)->data->CAN_EVOLVE == CAN_EVOLVE) { //pokemon can evolve
-        printf("Pokemon evolved from %s (ID %d) to %s (ID %d)\n", SearchPokemonBFS(owner->pokedexRoot, id)->data->name, id,
-                                                                pokedex[id].name, id + 1);
-        owner->pokedexRoot = ReleasePokemon(owner->pokedexRoot, SearchPokemonBFS(owner->pokedexRoot, id)->data); //case where evolving happens
-        owner->pokedexRoot = InsertPokemonNode(owner->pokedexRoot, id + 1, 1);
+    else {
+        uint32_t child = CompactInsertAt(dex, dex->nodes[node].right, species);
+        dex->nodes[node].right = child;
     }
+    return CompactRebalance(dex, node);
 }
 
-void MergePokedexMenu(void) {
-    OwnerNode *node = ownerHead;//first one in the list
-    if (ownerHead == NULL) {
-        printf("Not enough owners to merge.\n");
-        return;
+void CompactInsert(CompactPokedex *dex, int species) {
+    CompactReserve(dex, dex->count + 1); //grow first, so no index moves during the walk
+    dex->root = CompactInsertAt(dex, dex->root, species);
+}
+
+//removes `species` below node; *freed gets the array slot that is no longer in the tree
+static uint32_t CompactRemoveAt(CompactPokedex *dex, uint32_t node, int species, uint32_t *freed) {
+    CompactNode *n = &dex->nodes[node];
+    if (species < n->species) {
+        n->left = CompactRemoveAt(dex, n->left, species, freed);
+    }
+    else if (species > n->species) {
+        n->right = CompactRemoveAt(dex, n->right, species, freed);
     }
-    if (ownerHead == node->next) {
-        printf("Not enough owners to merge.\n");
+    else if (n->left == COMPACT_NIL || n->right == COMPACT_NIL) { //0 or 1 child
+        *freed = node;
+        return n->left == COMPACT_NIL ? n->right : n->left;
+    }
+    else { //two children: take the max of the left side, like ReleasePokemon
+        uint32_t max = n->left;
+        while (dex->nodes[max].right != COMPACT_NIL)
+            max = dex->nodes[max].right;
+        n->species = dex->nodes[max].species;
+        n->left = CompactRemoveAt(dex, n->left, n->species, freed);
+    }
+    return CompactRebalance(dex, node);
+}
+
+void CompactRemove(CompactPokedex *dex, int species) {
+    uint32_t freed = COMPACT_NIL;
+    dex->root = CompactRemoveAt(dex, dex->root, species, &freed);
+    uint32_t last = (uint32_t)--dex->count;
+    if (freed == last)
+        return;
+    //move the last node into the gap and point its parent at the new slot
+    dex->nodes[freed] = dex->nodes[last];
+    if (dex->root == last) {
+        dex->root = freed;
         return;
     }
-    printf("\n=== Merge Pokedexes ===\n");
-    char *owner1, *owner2;
-    printf("Enter name of first owner: ");
-    owner1 = getDynamicInput();
-    printf("Enter name of second owner: ");
-    owner2 = getDynamicInput();
-    if (FindOwnerByName(owner1)->pokedexRoot == NULL && FindOwnerByName(owner2)->pokedexRoot == NULL) {
-        printf("Both Pokedexes empty. Nothing to merge.\n");
-    }
-    printf("Merging %s and %s...\n", FindOwnerByName(owner1)->ownerName, FindOwnerByName(owner2)->ownerName);
-    //i need to add all of the stuff from the second one and if it exists then it wouldn't be added
-    //i need something like owner->pokemonroot = inseart(search) but for actually how long? for every pokemon????
-    //i have no idea how to optimise this shit
-    FindOwnerByName(owner1)->pokedexRoot = MergeTrees(FindOwnerByName(owner1)->pokedexRoot, FindOwnerByName(owner2)->pokedexRoot);
-    printf("Merge completed.\n");
-    FreeOwnerNode(FindOwnerByName(owner2));
-    printf("Owner '%s' has been removed after merging.", owner2);
-    free(owner1);
-    free(owner2);
-}
-
-PokemonNode *MergeTrees(PokemonNode *root1, PokemonNode *root2) {
-    //need to traverse in queue with bfs and insert into tree
-    if (root2 == NULL)
-        return root1;
-    Queue *queue = CreateQueue();//creating queue
-    Enqueue(queue, root2);//adding root of the second one to queue
-    while (queue->front != NULL) {
-        PokemonNode *node = Dequeue(queue); //deleting from queue
-        root1 = InsertPokemonNode(root1, node->data->id, 1);//inserting first element into queue
-        if (node->left != NULL)
-            Enqueue(queue, node->left);
-        if (node->right != NULL)
-            Enqueue(queue, node->right);
+    int moved = dex->nodes[freed].species;
+    uint32_t parent = dex->root;
+    for (;;) { //ordinary BST descent, species are unique
+        uint32_t *link = moved < dex->nodes[parent].species ? &dex->nodes[parent].left : &dex->nodes[parent].right;
+        if (*link == last) {
+            *link = freed;
+            return;
+        }
+        parent = *link;
     }
-    free(queue);
-    return root1;
 }
 
-OwnerNode *FindOwnerByName(const char *name) {
-    OwnerNode *owner = ownerHead;
-    do {
-        if (strcmp(owner->ownerName, name) == 0)
-            return owner;
-        owner = owner->next;
-    } while (owner != ownerHead);
-    return NULL;
+//sorted species[low..high] -> balanced subtree, nodes handed out in pre-order
+static uint32_t CompactBuild(CompactPokedex *dex, const uint8_t *species, int low, int high) {
+    if (low > high)
+        return COMPACT_NIL;
+    int mid = low + (high - low) / 2;
+    uint32_t node = (uint32_t)dex->count++;
+    dex->nodes[node].species = species[mid];
+    dex->nodes[node].left = CompactBuild(dex, species, low, mid - 1);
+    dex->nodes[node].right = CompactBuild(dex, species, mid + 1, high);
+    CompactUpdateHeight(dex, node);
+    return node;
+}
+
+void CompactRebuild(CompactPokedex *dex, const unsigned long long *owned) {
+    uint8_t species[POKEDEX_SIZE];
+    int size = BitmapSpecies(owned, species); //ascending, already sorted
+    dex->count = 0;
+    CompactReserve(dex, size);
+    dex->root = CompactBuild(dex, species, 0, size - 1);
 }
 
-void SortOwners(void) {//i'm guessing i need to put list in the array dymanically allocated and do the same quicksort
-    OwnerNode *owner = ownerHead;
-    if (ownerHead == NULL) { //i need to do array from the data in the list
-        printf("0 or 1 owners only => no need to sort.\n");
+void CompactDisplay(Session *session, const CompactPokedex *dex, TraversalOrder order) {
+    //same walks as CursorNext, with indices; a fixed stack/FIFO is enough for the same reason
+    uint32_t items[POKEDEX_SIZE];
+    int head = 0, top = 0;
+    uint32_t current = dex->root, lastVisited = COMPACT_NIL;
+    const CompactNode *nodes = dex->nodes;
+    if (dex->root == COMPACT_NIL)
         return;
+    switch (order) {
+    case ORDER_BFS:
+        items[top++] = dex->root;
+        while (head < top) {
+            uint32_t node = items[head++];
+            PrintPokemonData(session, &pokedex[nodes[node].species]);
+            if (nodes[node].left != COMPACT_NIL)
+                items[top++] = nodes[node].left;
+            if (nodes[node].right != COMPACT_NIL)
+                items[top++] = nodes[node].right;
+        }
+        break;
+    case ORDER_PRE:
+        items[top++] = dex->root;
+        while (top > 0) {
+            uint32_t node = items[--top];
+            PrintPokemonData(session, &pokedex[nodes[node].species]);
+            if (nodes[node].right != COMPACT_NIL)
+                items[top++] = nodes[node].right;
+            if (nodes[node].left != COMPACT_NIL)
+                items[top++] = nodes[node].left;
+        }
+        break;
+    case ORDER_IN:
+        while (current != COMPACT_NIL || top > 0) {
+            while (current != COMPACT_NIL) {
+                items[top++] = current;
+                current = nodes[current].left;
+            }
+            uint32_t node = items[--top];
+            PrintPokemonData(session, &pokedex[nodes[node].species]);
+            current = nodes[node].right;
+        }
+        break;
+    case ORDER_POST:
+        while (current != COMPACT_NIL || top > 0) {
+            if (current != COMPACT_NIL) {
+                items[top++] = current;
+                current = nodes[current].left;
+                continue;
+            }
+            uint32_t node = items[top - 1];
+            if (nodes[node].right != COMPACT_NIL && lastVisited != nodes[node].right) {
+                current = nodes[node].right;
+                continue;
+            }
+            top--;
+            lastVisited = node;
+            PrintPokemonData(session, &pokedex[nodes[node].species]);
+        }
+        break;
     }
-    if (ownerHead == owner->next) {
-        printf("0 or 1 owners only => no need to sort.\n");
-        return;
+}
+
+void CompactDisplayAlphabetical(Session *session, const CompactPokedex *dex) {
+    const PokemonData *slots[POKEDEX_SIZE] = {NULL};
+    for (int i = 0; i < dex->count; i++) { //array order is fine, the ranks do the sorting
+        const PokemonData *data = &pokedex[dex->nodes[i].species];
+        slots[pokedexAlphaRank[data->id]] = data;
     }
-    int size = 0;
-    ownerNames = InitOwnerArray(ownerHead, &size);
-    //i will scream i swear i will
-    BubbleSort(ownerNames, &size); //putting everything back in the list?
-    for (int i = 0; i < size; i++) {
-        owner->ownerName = ownerNames[i]->ownerName;
-        owner->pokedexRoot = ownerNames[i]->pokedexRoot;
-        owner = owner->next;
+    for (int i = 0; i < POKEDEX_SIZE; i++) {
+        if (slots[i] != NULL)
+            PrintPokemonData(session, slots[i]);
     }
-    printf("Owners sorted by name.");
-    free(ownerNames); //freeing array
 }
 
-OwnerNode** InitOwnerArray(OwnerNode *owner, int *size) { //array of owner names i hope
-    int capacity = 10;
-    ownerNames = malloc(sizeof(OwnerNode *) * capacity);
-    if (ownerNames == NULL) {
-        printf("Memory allocation error.\n");
-        exit(1);
+size_t PokedexBytes(const OwnerNode *owner) {
+    if (pokedexLayout == LAYOUT_COMPACT)
+        return sizeof(CompactNode) * (size_t)owner->compact.capacity;
+    size_t bytes = 0;
+    for (const PokemonBlock *block = owner->arena.blocks; block != NULL; block = block->next)
+        bytes += sizeof(PokemonBlock);
+    return bytes;
+}
+
+void PrintMemoryReport(Session *session) {
+    size_t nodeSize = pokedexLayout == LAYOUT_COMPACT ? sizeof(CompactNode) : sizeof(PokemonNode);
+    size_t totalBytes = 0;
+    long totalPokemon = 0;
+    int owners = 0;
+    fprintf(stderr, "Memory report (%s layout, %zu bytes per node):\n",
+            pokedexLayout == LAYOUT_COMPACT ? "compact" : "tree", nodeSize);
+    OwnerNode *owner = session->registry->ownerHead;
+    if (owner != NULL) {
+        do {
+            size_t bytes = PokedexBytes(owner);
+            int count = OwnerPokemonCount(owner);
+            fprintf(stderr, "  %s: %d Pokemon, %zu bytes allocated (%zu in live nodes)\n",
+                    owner->ownerName, count, bytes, nodeSize * (size_t)count);
+            totalBytes += bytes;
+            totalPokemon += count;
+            owners++;
+            owner = owner->next;
+        } while (owner != session->registry->ownerHead);
     }
-    do {
-        if (*size >= capacity) {
-            capacity *= 2;
-            ownerNames = realloc(ownerNames, sizeof(OwnerNode *) * capacity);
-            if (ownerNames == NULL) {
-                printf("Memory allocation error.\n");
-                exit(1);
-            }
-        }
-        ownerNames[*size] = owner;
-        (*size)++;
-        owner = owner->next;
-    } while (owner->next != ownerHead);
-    return ownerNames;
+    size_t sharedBytes = 0; //cloned Pokedexes keep their nodes in one pool, not per owner
+    for (const PokemonBlock *block = session->registry->memoryPools.sharedNodes.blocks; block != NULL; block = block->next)
+        sharedBytes += sizeof(PokemonBlock);
+    if (sharedBytes > 0) {
+        fprintf(stderr, "  shared nodes: %zu bytes allocated\n", sharedBytes);
+        totalBytes += sharedBytes;
+    }
+    fprintf(stderr, "Total: %d owners, %ld Pokemon, %zu bytes", owners, totalPokemon, totalBytes);
+    if (owners > 0)
+        fprintf(stderr, " (%zu per owner)", totalBytes / (size_t)owners);
+    fprintf(stderr, "\n");
 }
 
-void BubbleSort(OwnerNode **ownerNames, int *size) {
-    for (int i = 0; i < *size - 1; i++) {
-        for (int j = 0; j < *size - i - 1; j++) {
-            if (CompareByNameOwners(&ownerNames[j]->ownerName, &ownerNames[j + 1]->ownerName) > 0) {
-                SwapOwnerData(ownerNames[j], ownerNames[j + 1]);
-            }
+void PokedexInsert(Session *session, OwnerNode *owner, int id) {
+    if (pokedexLayout == LAYOUT_COMPACT) {
+        CompactInsert(&owner->compact, id - 1);
+    }
+    else if (owner->shared) { //copy the path, whoever shares the old one keeps it
+        pthread_mutex_lock(&session->registry->memoryPools.sharedLock);
+        owner->pokedexRoot = SharedInsert(session, owner->pokedexRoot, id);
+        pthread_mutex_unlock(&session->registry->memoryPools.sharedLock);
+    }
+    else {
+        owner->pokedexRoot = InsertPokemonNode(session, &owner->arena, owner->pokedexRoot, id, 1);
+    }
+    MarkOwned(owner, id);
+}
+
+void PokedexRemove(Session *session, OwnerNode *owner, int id) {
+    if (pokedexLayout == LAYOUT_COMPACT) {
+        CompactRemove(&owner->compact, id - 1);
+    }
+    else if (owner->shared) {
+        pthread_mutex_lock(&session->registry->memoryPools.sharedLock);
+        owner->pokedexRoot = SharedRemove(session, owner->pokedexRoot, id);
+        pthread_mutex_unlock(&session->registry->memoryPools.sharedLock);
+    }
+    else {
+        owner->pokedexRoot = ReleasePokemon(&owner->arena, owner->pokedexRoot, (PokemonData *)&pokedex[id - 1]);
+    }
+    UnmarkOwned(owner, id);
+}
+
+void InitSpeciesTable(void) {
+    for (int i = 0; i < POKEDEX_SIZE; i++) {
+        speciesTable.id[i] = pokedex[i].id;
+        speciesTable.hp[i] = pokedex[i].hp;
+        speciesTable.attack[i] = pokedex[i].attack;
+        speciesTable.type[i] = (unsigned char)pokedex[i].TYPE;
+        speciesTable.canEvolve[i] = (unsigned char)pokedex[i].CAN_EVOLVE;
+    }
+    ScoreColumns(speciesTable.hp, speciesTable.attack, POKEDEX_SIZE, speciesTable.score);
+    for (int i = 0; i < POKEDEX_SIZE; i++) { //151x151 once at startup
+        int16_t below = 0;
+        for (int j = 0; j < POKEDEX_SIZE; j++)
+            below += speciesTable.score[j] < speciesTable.score[i];
+        speciesTable.scoreRank[i] = below;
+    }
+    for (int i = 0; i < POKEDEX_SIZE; i++) { //insertion sort, strongest first, lower ID first on a tie
+        int j = i;
+        while (j > 0 && speciesTable.scoreRank[speciesTable.byScore[j - 1]] < speciesTable.scoreRank[i]) {
+            speciesTable.byScore[j] = speciesTable.byScore[j - 1];
+            j--;
         }
+        speciesTable.byScore[j] = (uint8_t)i;
     }
 }
 
-void SwapOwnerData(OwnerNode *a, OwnerNode *b) { //mega swap
-    PokemonNode *temp = a->pokedexRoot;
-    a->pokedexRoot = b->pokedexRoot;
-    b->pokedexRoot = temp;
-    char *temp2 = a->ownerName;
-    a->ownerName = b->ownerName;
-    b->ownerName = temp2;
+void ScoreColumns(const int *restrict hp, const int *restrict attack, int count, double *restrict out) {
+    for (int i = 0; i < count; i++) //same expression as the old fight code, so the doubles match bit for bit
+        out[i] = hp[i] * 1.2 + attack[i] * 1.5;
 }
 
-int CompareByNameOwners(const void *a, const void *b) {
-    char *name1 = *(char **)a;
-    char *name2 = *(char **)b;
-    return strcmp(name1, name2);
+void ScoreSpeciesBatch(const uint8_t *restrict species, int count, double *restrict out) {
+    const double *score = speciesTable.score;
+    for (int i = 0; i < count; i++) //a gather, vectorized where the target has one
+        out[i] = score[species[i]];
 }
 
-void PrintOwnersCircular(void) {
-    OwnerNode *owner = ownerHead;
-    if (owner == NULL) {
-        printf("No owners.\n");
-        return;
+void RankSpeciesBatch(const uint8_t *restrict species, int count, int16_t *restrict out) {
+    const int16_t *rank = speciesTable.scoreRank;
+    for (int i = 0; i < count; i++)
+        out[i] = rank[species[i]];
+}
+
+void ScoreIdBatch(const int *restrict ids, int count, double *restrict out) {
+    const double *score = speciesTable.score;
+    for (int i = 0; i < count; i++) //IDs are 1-based
+        out[i] = score[ids[i] - 1];
+}
+
+int BitmapSpecies(const unsigned long long *owned, uint8_t *species) {
+    int size = 0;
+    for (int w = 0; w < POKEDEX_WORDS; w++) {
+        for (unsigned long long bits = owned[w]; bits != 0; bits &= bits - 1)
+            species[size++] = (uint8_t)(w * 64 + LowestBit(bits));
     }
-    char direction;
-    while (1) {
-        printf("Enter direction (F or B): ");
-        scanf(" %c", &direction);
-        if (direction != 'F' && direction != 'B' && direction != 'f' && direction != 'b') {
-            printf("Invalid direction, must be F or B.");
-        }
-        else
-            break;
+    return size;
+}
+
+int ScoreRoster(const OwnerNode *owner, uint8_t *species, double *scores) {
+    int count = BitmapSpecies(owner->owned, species);
+    ScoreSpeciesBatch(species, count, scores);
+    return count;
+}
+
+void PokemonFight(Session *session, OwnerNode *owner) {
+    if (OwnerPokemonCount(owner) == 0) {
+        OutStr(session, "Pokedex is empty.\n");
+        return;
     }
-    scanf("%*c");
-    printf("How many prints? ");
-    int num;
-    num = readIntSafe("");
-    if (num < 0) {
-        printf("Invalid number.\n");
+    int id1, id2;
+    OutPrompt(session, "Enter ID of the first Pokemon: ");
+    id1 = readIntSafe(session, "");
+    OutPrompt(session, "Enter ID of the second Pokemon: ");
+    id2 = readIntSafe(session, "");
+    FightPokemon(session, owner, id1, id2);
+}
+
+void FightPokemon(Session *session, const OwnerNode *owner, int id1, int id2) {
+    FightOwned(session, owner->owned, id1, id2);
+}
+
+void FightOwned(Session *session, const unsigned long long *owned, int id1, int id2) {
+    //two bit checks and the data comes straight from the static table, no tree walk at all
+    if (!OwnedHas(owned, id1) || !OwnedHas(owned, id2)) {
+        OutStr(session, "One or both Pokemon IDs not found.\n");
         return;
     }
-    if (direction == 'F' || direction == 'f') {
-        for (int i = 0; i < num; i++) {
-            printf("[%d] ", i + 1);
-            printf("%s\n", owner->ownerName);
-            owner = owner->next;
+    const PokemonData *first = &pokedex[id1 - 1];
+    const PokemonData *second = &pokedex[id2 - 1];
+    int ids[2] = {id1, id2};
+    double scores[2];
+    ScoreIdBatch(ids, 2, scores);
+    double score1 = scores[0], score2 = scores[1];
+    OutPrintf(session, "Pokemon 1: %s ", first->name);
+    OutPrintf(session, "(Score = %.2f)\n", score1);
+    OutPrintf(session, "Pokemon 2: %s ", second->name);
+    OutPrintf(session, "(Score = %.2f)\n", score2);
+    if (score1 > score2)
+        OutPrintf(session, "%s wins!\n", first->name);
+    else if (score2 > score1)
+        OutPrintf(session, "%s wins!\n", second->name);
+    else
+        OutStr(session, "It's a tie!\n");
+}
+
+void TournamentKernel(const int16_t *restrict rowRanks, int rows, const int16_t *restrict colRanks, int cols,
+                      int *restrict wins, int *restrict losses, int *restrict ties) {
+    for (int i = 0; i < rows; i++) {
+        int16_t rank = rowRanks[i];
+        int16_t won = 0, lost = 0; //16-bit lanes all the way (151 fits), 8 compares per SSE2 op
+        for (int j = 0; j < cols; j++) { //no branches, just two compares summed
+            won += colRanks[j] < rank;
+            lost += colRanks[j] > rank;
         }
+        wins[i] = won;
+        losses[i] = lost;
+        ties[i] = cols - won - lost;
     }
-    else {
-        for (int i = 0; i < num; i++) {
-            printf("[%d] ", i + 1);
-            printf("%s\n", owner->ownerName);
-            owner = owner->prev;
+}
+
+//standings order: more wins first, then more ties, then higher score, then lower ID
+static int StandingBefore(const int *wins, const int *ties, const uint8_t *species, int a, int b) {
+    if (wins[a] != wins[b])
+        return wins[a] > wins[b];
+    if (ties[a] != ties[b])
+        return ties[a] > ties[b];
+    if (speciesTable.scoreRank[species[a]] != speciesTable.scoreRank[species[b]])
+        return speciesTable.scoreRank[species[a]] > speciesTable.scoreRank[species[b]];
+    return species[a] < species[b];
+}
+
+static void PrintStandings(Session *session, const char *ownerName, const uint8_t *species, const double *scores,
+                           const int *wins, const int *losses, const int *ties, int count) {
+    int order[POKEDEX_SIZE];
+    for (int i = 0; i < count; i++) { //insertion sort, at most 151 rows
+        int j = i;
+        while (j > 0 && StandingBefore(wins, ties, species, i, order[j - 1])) {
+            order[j] = order[j - 1];
+            j--;
         }
+        order[j] = i;
+    }
+    OutPrintf(session, "-- %s's standings --\n", ownerName);
+    for (int r = 0; r < count; r++) {
+        int i = order[r];
+        OutInt(session, r + 1);
+        OutStr(session, ". ");
+        OutStr(session, pokedex[species[i]].name);
+        OutStr(session, " (ID ");
+        OutInt(session, pokedex[species[i]].id);
+        OutPrintf(session, ", Score = %.2f) W: ", scores[i]);
+        OutInt(session, wins[i]);
+        OutStr(session, " L: ");
+        OutInt(session, losses[i]);
+        OutStr(session, " T: ");
+        OutInt(session, ties[i]);
+        OutChar(session, '\n');
     }
 }
 
-void FreeAllOwners(void) {
-    if (ownerHead == NULL) {
+void RunTournament(Session *session, const OwnerNode *owner, const OwnerNode *opponent) {
+    uint8_t species[POKEDEX_SIZE], otherSpecies[POKEDEX_SIZE];
+    double scores[POKEDEX_SIZE], otherScores[POKEDEX_SIZE];
+    int16_t ranks[POKEDEX_SIZE] = {0}, otherRanks[POKEDEX_SIZE] = {0}; //(gcc can't tell the batch fills them)
+    int wins[POKEDEX_SIZE], losses[POKEDEX_SIZE], ties[POKEDEX_SIZE];
+    int count = ScoreRoster(owner, species, scores);
+    RankSpeciesBatch(species, count, ranks);
+    if (opponent == NULL || opponent == owner) {
+        TournamentKernel(ranks, count, ranks, count, wins, losses, ties);
+        for (int i = 0; i < count; i++)
+            ties[i]--; //nobody fights themselves
+        OutPrintf(session, "Tournament in %s's Pokedex: %d Pokemon, %d fights.\n",
+                  owner->ownerName, count, count * (count - 1) / 2);
+        PrintStandings(session, owner->ownerName, species, scores, wins, losses, ties, count);
         return;
     }
-    OwnerNode *owner;
-    OwnerNode *current = ownerHead;
-    do {
-        owner = current->next; //next owner
-        FreePokemonTree(current->pokedexRoot); //freeing tree
-        free(current->ownerName);//freeing name
-        free(current); //freeing pointer
-        current = owner;
-    } while (owner != ownerHead);
-    //printf("and we're golden\n");
-    ownerHead = NULL;
-}
\ No newline at end of file
+    int otherCount = ScoreRoster(opponent, otherSpecies, otherScores);
+    RankSpeciesBatch(otherSpecies, otherCount, otherRanks);
+    int otherWins[POKEDEX_SIZE], otherLosses[POKEDEX_SIZE], otherTies[POKEDEX_SIZE];
+    TournamentKernel(ranks, count, otherRanks, otherCount, wins, losses, ties);
+    TournamentKernel(otherRanks, otherCount, ranks, count, otherWins, otherLosses, otherTies);
+    int totalWins = 0, totalLosses = 0;
+    for (int i = 0; i < count; i++) {
+        totalWins += wins[i];
+        totalLosses += losses[i];
+    }
+    OutPrintf(session, "Tournament %s vs %s: %d fights.\n", owner->ownerName, opponent->ownerName, count * otherCount);
+    PrintStandings(session, owner->ownerName, species, scores, wins, losses, ties, count);
+    PrintStandings(session, opponent->ownerName, otherSpecies, otherScores, otherWins, otherLosses, otherTies, otherCount);
+    OutPrintf(session, "%s won %d, %s won %d, %d ties.\n", owner->ownerName, totalWins, opponent->ownerName, totalLosses,
+              count * otherCount - totalWins - totalLosses);
+}
+
+void TournamentMenu(Session *session, OwnerNode *owner) {
+    if (OwnerPokemonCount(owner) == 0) {
+        OutStr(session, "Pokedex is empty.\n");
+        return;
+    }
+    OutPrompt(session, "Opponent's name (empty for a tournament inside this Pokedex): ");
+    char *name = getDynamicInput(session);
+    OwnerNode *opponent = NULL;
+    if (*name != '\0') {
+        opponent = FindOwnerByName(session, name);
+        if (opponent == NULL) {
+            OutStr(session, "Owner not found.\n");
+            return;
+        }
+        if (OwnerPokemonCount(opponent) == 0) {
+            OutPrintf(session, "%s's Pokedex is empty.\n", opponent->ownerName);
+            return;
+        }
+    }
+    RunTournament(session, owner, opponent);
+}
+
+void EvolvePokemon(Session *session, OwnerNode *owner) {
+    if (OwnerPokemonCount(owner) == 0) {
+        OutStr(session, "Cannot evolve. Pokedex empty.\n");
+        return;
+    }
+    int id;
+    OutPrompt(session, "Enter ID of Pokemon to evolve: \n");
+    id = readIntSafe(session, "");
+    EvolvePokemonId(session, owner, id);
+}
+
+int EvolvePokemonId(Session *session, OwnerNode *owner, int id) {
+    if (!OwnerHasPokemon(owner, id)) { //there is no pokemon in pokedex (or id out of bounds)
+        OutPrintf(session, "No pokemon with ID %d found.\n", id);
+        return 0;
+    }
+    PokemonData *data = (PokemonData *)&pokedex[id - 1]; //same pointer the node holds
+    if (speciesTable.canEvolve[id - 1] == CANNOT_EVOLVE) {//pokemon cannot evolve
+        OutPrintf(session, "%s (ID %d) cannot evolve.\n", data->name, id);
+        return 0;
+    }
+    OutPrintf(session, "Pokemon evolved from %s (ID %d) to %s (ID %d)\n", data->name, id, pokedex[id].name, id + 1);
+    PokedexRemove(session, owner, id); //case where evolving happens
+    if (!OwnerHasPokemon(owner, id + 1))
+        PokedexInsert(session, owner, id + 1);
+    JournalLog(session, JOURNAL_EVOLVE, id, owner->ownerName, NULL);
+    return 1;
+}
+
+void MergePokedexMenu(Session *session) {
+    OwnerNode *node = session->registry->ownerHead;//first one in the list
+    if (session->registry->ownerHead == NULL) {
+        OutStr(session, "Not enough owners to merge.\n");
+        return;
+    }
+    if (session->registry->ownerHead == node->next) {
+        OutStr(session, "Not enough owners to merge.\n");
+        return;
+    }
+    OutPrompt(session, "\n=== Merge Pokedexes ===\n");
+    char *owner1, *owner2;
+    OutPrompt(session, "Enter name of first owner: ");
+    owner1 = getDynamicInput(session);
+    OwnerNode *first = FindOwnerByName(session, owner1); //looking it up now, owner1 is gone after the next read
+    OutPrompt(session, "Enter name of second owner: ");
+    owner2 = getDynamicInput(session);
+    OwnerNode *second = FindOwnerByName(session, owner2);
+    if (first == NULL || second == NULL) {
+        OutStr(session, "Owner not found.\n");
+        return;
+    }
+    MergeOwnerPair(session, first, second, owner2);
+}
+
+void MergeOwnerPair(Session *session, OwnerNode *first, OwnerNode *second, const char *secondName) {
+    if (OwnerPokemonCount(first) == 0 && OwnerPokemonCount(second) == 0) {
+        OutStr(session, "Both Pokedexes empty. Nothing to merge.\n");
+    }
+    OutPrintf(session, "Merging %s and %s...\n", first->ownerName, second->ownerName);
+    JournalLog(session, JOURNAL_MERGE, 0, first->ownerName, second->ownerName); //second's name is gone afterwards
+    //i need to add all of the stuff from the second one and if it exists then it wouldn't be added
+    //i need something like owner->pokemonroot = inseart(search) but for actually how long? for every pokemon????
+    //i have no idea how to optimise this shit
+    MergeTrees(session, first, second);
+    OutStr(session, "Merge completed.\n");
+    FreeOwnerNode(session, second);
+    OutPrintf(session, "Owner '%s' has been removed after merging.", secondName);
+}
+
+void MergeTrees(Session *session, OwnerNode *first, OwnerNode *second) {
+    if (first == second) //merging with yourself changes nothing (and would recycle live nodes)
+        return;
+    if (pokedexLayout == LAYOUT_COMPACT) { //union of the bitmaps is the merged Pokedex, in ID order
+        for (int w = 0; w < POKEDEX_WORDS; w++) {
+            first->owned[w] |= second->owned[w];
+            second->owned[w] = 0;
+        }
+        CompactRebuild(&first->compact, first->owned);
+        CompactFree(&second->compact);
+        return;
+    }
+    if (first->shared || second->shared) { //nodes someone else may point at can't be relinked
+        MergeShared(session, first, second);
+        return;
+    }
+    PokemonNode *left[POKEDEX_SIZE], *right[POKEDEX_SIZE], *merged[POKEDEX_SIZE]; //never more than 151 each
+    int leftSize = FlattenInOrder(first->pokedexRoot, left);
+    int rightSize = FlattenInOrder(second->pokedexRoot, right);
+    SpliceArena(&first->arena, &second->arena); //second's nodes are first's now
+    int i = 0, j = 0, size = 0;
+    while (i < leftSize && j < rightSize) { //classic sorted merge
+        if (left[i]->data->id < right[j]->data->id) {
+            merged[size++] = left[i++];
+        }
+        else if (left[i]->data->id > right[j]->data->id) {
+            merged[size++] = right[j++];
+        }
+        else { //both have it, keep first's node and recycle the other one
+            merged[size++] = left[i++];
+            ArenaFreeNode(&first->arena, right[j++]);
+        }
+    }
+    while (i < leftSize)
+        merged[size++] = left[i++];
+    while (j < rightSize)
+        merged[size++] = right[j++];
+    first->pokedexRoot = BuildBalanced(merged, 0, size - 1);
+    for (int w = 0; w < POKEDEX_WORDS; w++) { //bitmap union is just an OR
+        first->owned[w] |= second->owned[w];
+        second->owned[w] = 0;
+    }
+    second->pokedexRoot = NULL; //nothing left, its nodes live in first's tree
+}
+
+int FlattenInOrder(PokemonNode *root, PokemonNode **out) {
+    TreeCursor cursor;
+    CursorInit(&cursor, root, ORDER_IN);
+    int size = 0;
+    PokemonNode *node;
+    while ((node = CursorNext(&cursor)) != NULL)
+        out[size++] = node;
+    return size;
+}
+
+PokemonNode *BuildBalanced(PokemonNode **nodes, int low, int high) {
+    if (low > high)
+        return NULL;
+    int mid = low + (high - low) / 2; //middle one is the root so both sides are the same size
+    PokemonNode *root = nodes[mid];
+    root->left = BuildBalanced(nodes, low, mid - 1);
+    root->right = BuildBalanced(nodes, mid + 1, high);
+    UpdateHeight(root);
+    return root;
+}
+
+OwnerNode *FindOwnerByName(Session *session, const char *name) {
+    OwnerIndex *table = &session->registry->ownerIndex;
+    if (table->count == 0)
+        return NULL;
+    unsigned int hash = HashOwnerName(name);
+    int mask = table->capacity - 1;
+    for (int i = (int)(hash & (unsigned int)mask); table->slots[i].owner != NULL; i = (i + 1) & mask) {
+        if (table->slots[i].hash == hash && strcmp(table->slots[i].owner->ownerName, name) == 0)
+            return table->slots[i].owner;
+    }
+    return NULL; //hit an empty slot => not there
+}
+
+unsigned int HashOwnerName(const char *name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    //FNV's low bits are weak for names like "owner123", mix before the table masks them off
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+void ReserveOwnerIndex(Session *session, int count) {
+    OwnerIndex *table = &session->registry->ownerIndex;
+    if (count * 2 <= table->capacity) //keep load under half so probes stay short
+        return;
+    OwnerSlot *old = table->slots;
+    int oldCapacity = table->capacity;
+    int capacity = oldCapacity == 0 ? OWNER_INDEX_MIN_CAPACITY : oldCapacity * 2;
+    while (count * 2 > capacity)
+        capacity *= 2;
+    table->slots = (OwnerSlot *)calloc((size_t)capacity, sizeof(OwnerSlot));
+    if (table->slots == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    table->capacity = capacity;
+    for (int i = 0; i < oldCapacity; i++) { //rehash everything into the bigger table
+        if (old[i].owner == NULL)
+            continue;
+        int j = (int)(old[i].hash & (unsigned int)(capacity - 1));
+        while (table->slots[j].owner != NULL)
+            j = (j + 1) & (capacity - 1);
+        table->slots[j] = old[i];
+    }
+    free(old);
+}
+
+void IndexOwner(Session *session, OwnerNode *owner) {
+    OwnerIndex *table = &session->registry->ownerIndex;
+    ReserveOwnerIndex(session, table->count + 1);
+    unsigned int hash = HashOwnerName(owner->ownerName);
+    int mask = table->capacity - 1;
+    int i = (int)(hash & (unsigned int)mask);
+    while (table->slots[i].owner != NULL)
+        i = (i + 1) & mask;
+    table->slots[i].owner = owner;
+    table->slots[i].hash = hash;
+    table->count++;
+}
+
+void UnindexOwner(Session *session, OwnerNode *owner) {
+    OwnerIndex *table = &session->registry->ownerIndex;
+    if (table->count == 0 || owner->ownerName == NULL)
+        return;
+    int mask = table->capacity - 1;
+    int i = (int)(HashOwnerName(owner->ownerName) & (unsigned int)mask);
+    while (table->slots[i].owner != owner) {
+        if (table->slots[i].owner == NULL)
+            return; //not indexed
+        i = (i + 1) & mask;
+    }
+    //backward shift: pull later entries of the same cluster into the hole so no probe chain breaks
+    int hole = i;
+    for (int j = (i + 1) & mask; table->slots[j].owner != NULL; j = (j + 1) & mask) {
+        int home = (int)(table->slots[j].hash & (unsigned int)mask);
+        //entry j can move to the hole only if its home isn't between the hole and j (cyclically)
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            table->slots[hole] = table->slots[j];
+            hole = j;
+        }
+    }
+    table->slots[hole].owner = NULL;
+    table->count--;
+}
+
+void RebuildOwnerIndex(Session *session) {
+    OwnerIndex *table = &session->registry->ownerIndex;
+    if (table->slots != NULL)
+        memset(table->slots, 0, (size_t)table->capacity * sizeof(OwnerSlot));
+    table->count = 0;
+    if (session->registry->ownerHead == NULL)
+        return;
+    OwnerNode *owner = session->registry->ownerHead;
+    do {
+        IndexOwner(session, owner);
+        owner = owner->next;
+    } while (owner != session->registry->ownerHead);
+}
+
+void FreeOwnerIndex(Session *session) {
+    OwnerIndex *table = &session->registry->ownerIndex;
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = table->count = 0;
+}
+
+void SortOwners(Session *session) {//i'm guessing i need to put list in the array dymanically allocated and do the same quicksort
+    OwnerNode *owner = session->registry->ownerHead;
+    if (session->registry->ownerHead == NULL) { //i need to do array from the data in the list
+        OutStr(session, "0 or 1 owners only => no need to sort.\n");
+        return;
+    }
+    if (session->registry->ownerHead == owner->next) {
+        OutStr(session, "0 or 1 owners only => no need to sort.\n");
+        return;
+    }
+    int size = 0;
+    session->ownerNames = InitOwnerArray(session, session->registry->ownerHead, &size);
+    //i will scream i swear i will
+    BubbleSort(session->ownerNames, &size); //putting everything back in the list?
+    for (int i = 0; i < size; i++) {
+        owner->ownerName = session->ownerNames[i]->ownerName;
+        owner->pokedexRoot = session->ownerNames[i]->pokedexRoot;
+        owner = owner->next;
+    }
+    OutStr(session, "Owners sorted by name.");
+    JournalLog(session, JOURNAL_SORT, 0, NULL, NULL);
+    free(session->ownerNames); //freeing array
+    session->ownerNames = NULL;
+    RebuildOwnerIndex(session); //names moved between nodes
+}
+
+OwnerNode** InitOwnerArray(Session *session, OwnerNode *owner, int *size) { //array of owner names i hope
+    int capacity = 10;
+    session->ownerNames = malloc(sizeof(OwnerNode *) * capacity);
+    if (session->ownerNames == NULL) {
+        OutStr(session, "Memory allocation error.\n");
+        exit(1);
+    }
+    do {
+        if (*size >= capacity) {
+            capacity *= 2;
+            session->ownerNames = realloc(session->ownerNames, sizeof(OwnerNode *) * capacity);
+            if (session->ownerNames == NULL) {
+                OutStr(session, "Memory allocation error.\n");
+                exit(1);
+            }
+        }
+        session->ownerNames[*size] = owner;
+        (*size)++;
+        owner = owner->next;
+    } while (owner->next != session->registry->ownerHead);
+    return session->ownerNames;
+}
+
+void BubbleSort(OwnerNode **ownerNames, int *size) {
+    for (int i = 0; i < *size - 1; i++) {
+        for (int j = 0; j < *size - i - 1; j++) {
+            if (CompareByNameOwners(&ownerNames[j]->ownerName, &ownerNames[j + 1]->ownerName) > 0) {
+                SwapOwnerData(ownerNames[j], ownerNames[j + 1]);
+            }
+        }
+    }
+}
+
+void SwapOwnerData(OwnerNode *a, OwnerNode *b) { //mega swap
+    PokemonNode *temp = a->pokedexRoot;
+    a->pokedexRoot = b->pokedexRoot;
+    b->pokedexRoot = temp;
+    PokemonArena tempArena = a->arena; //the nodes belong to the arena so it travels with the tree
+    a->arena = b->arena;
+    b->arena = tempArena;
+    int tempShared = a->shared; //or they're in the shared pool
+    a->shared = b->shared;
+    b->shared = tempShared;
+    CompactPokedex tempCompact = a->compact;
+    a->compact = b->compact;
+    b->compact = tempCompact;
+    for (int w = 0; w < POKEDEX_WORDS; w++) { //and so does the bitmap
+        unsigned long long tempBits = a->owned[w];
+        a->owned[w] = b->owned[w];
+        b->owned[w] = tempBits;
+    }
+    char *temp2 = a->ownerName;
+    a->ownerName = b->ownerName;
+    b->ownerName = temp2;
+}
+
+int CompareByNameOwners(const void *a, const void *b) {
+    char *name1 = *(char **)a;
+    char *name2 = *(char **)b;
+    return strcmp(name1, name2);
+}
+
+void PrintOwnersCircular(Session *session) {
+    if (session->snapshot != NULL ? session->snapshot->count == 0 : session->registry->ownerHead == NULL) {
+        OutStr(session, "No owners.\n");
+        return;
+    }
+    int direction;
+    while (1) {
+        OutPrompt(session, "Enter direction (F or B): ");
+        OutFlushBeforeInput(session);
+        do { //same as scanf(" %c"): skip blanks and newlines, take one char
+            direction = NextChar(session);
+        } while (direction != EOF && isspace(direction));
+        if (direction == EOF)
+            EndOfInput(session);
+        if (direction != 'F' && direction != 'B' && direction != 'f' && direction != 'b') {
+            OutStr(session, "Invalid direction, must be F or B.");
+        }
+        else
+            break;
+    }
+    NextChar(session); //and the char after it (the newline), like scanf("%*c")
+    OutPrompt(session, "How many prints? ");
+    int num;
+    num = readIntSafe(session, "");
+    PrintOwnersDirection(session, direction == 'F' || direction == 'f', num);
+}
+
+void PrintOwnersDirection(Session *session, int forward, int num) {
+    if (session->snapshot != NULL) {
+        ViewPrintDirection(session, forward, num);
+        return;
+    }
+    OwnerNode *owner = session->registry->ownerHead;
+    if (owner == NULL) {
+        OutStr(session, "No owners.\n");
+        return;
+    }
+    if (num < 0) {
+        OutStr(session, "Invalid number.\n");
+        return;
+    }
+    if (forward) {
+        for (int i = 0; i < num; i++) {
+            OutChar(session, '[');
+            OutInt(session, i + 1);
+            OutStr(session, "] ");
+            OutStr(session, owner->ownerName);
+            OutChar(session, '\n');
+            owner = owner->next;
+        }
+    }
+    else {
+        for (int i = 0; i < num; i++) {
+            OutChar(session, '[');
+            OutInt(session, i + 1);
+            OutStr(session, "] ");
+            OutStr(session, owner->ownerName);
+            OutChar(session, '\n');
+            owner = owner->prev;
+        }
+    }
+}
+
+void FreeAllOwners(Session *session) {
+    FreeOwnerIndex(session); //nothing left to look up
+    FreeOwnerDirectory(session);
+    ReleaseArena(session, &session->registry->memoryPools.sharedNodes); //shared Pokedexes go all at once too
+    if (session->registry->ownerHead == NULL) {
+        return;
+    }
+    OwnerNode *owner;
+    OwnerNode *current = session->registry->ownerHead;
+    do {
+        owner = current->next; //next owner
+        ReleaseArena(session, &current->arena); //no tree walk, the blocks just go to the spare list
+        CompactFree(&current->compact);
+        free(current->ownerName);//freeing name
+        current = owner;
+    } while (owner != session->registry->ownerHead);
+    //printf("and we're golden\n");
+    session->registry->ownerHead = NULL;
+}
+void OwnerLineup(const OwnerNode *owner, int games, int16_t *ranks) {
+    int filled = 0;
+    for (int i = 0; i < POKEDEX_SIZE && filled < games; i++) { //strongest species first, keep the owned ones
+        int species = speciesTable.byScore[i];
+        if ((owner->owned[species / 64] >> (species % 64)) & 1ULL)
+            ranks[filled++] = speciesTable.scoreRank[species];
+    }
+    while (filled < games)
+        ranks[filled++] = -1; //no Pokemon left => loses that game to anyone who has one
+}
+
+//one row of the match triangle: lineup `row` against every lineup after it
+static void PlayLeagueRow(LeagueWorker *worker, int row) {
+    const League *league = worker->league;
+    int lineups = league->lineups;
+    int16_t *diff = worker->diff;
+    for (int j = row + 1; j < lineups; j++)
+        diff[j] = 0;
+    for (int g = 0; g < league->games; g++) { //game by game over the whole row, the inner loop vectorizes
+        const int16_t *column = league->top + (size_t)g * lineups;
+        int16_t mine = column[row];
+        for (int j = row + 1; j < lineups; j++)
+            diff[j] += (column[j] < mine) - (column[j] > mine); //+1 row won game g, -1 row lost it
+    }
+    const int *members = league->members;
+    int *wins = worker->wins, *draws = worker->draws, *losses = worker->losses;
+    int rowMembers = members[row];
+    int won = 0, drawn = 0, lost = 0; //never more than the owner count, int is enough (and vectorizes)
+    for (int j = row + 1; j < lineups; j++) {
+        int others = members[j];
+        int win = diff[j] > 0, loss = diff[j] < 0;
+        int draw = 1 - win - loss;
+        won += win * others;
+        drawn += draw * others;
+        lost += loss * others;
+        wins[j] += loss * rowMembers; //the other side of the same matches
+        draws[j] += draw * rowMembers;
+        losses[j] += win * rowMembers;
+    }
+    wins[row] += won;
+    draws[row] += drawn;
+    losses[row] += lost;
+}
+
+//take the back half of some other worker's queue; 0 when every queue is empty
+static int StealRows(LeagueWorker *thief) {
+    League *league = thief->league;
+    int self = (int)(thief - league->workers);
+    for (int k = 1; k < league->threads; k++) {
+        LeagueWorker *victim = &league->workers[(self + k) % league->threads];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->next;
+        int take = (left + 1) / 2;
+        int end = victim->end;
+        victim->end -= take;
+        pthread_mutex_unlock(&victim->lock); //never hold two locks, thieves can steal from each other
+        if (take > 0) {
+            pthread_mutex_lock(&thief->lock);
+            thief->next = end - take;
+            thief->end = end;
+            pthread_mutex_unlock(&thief->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void *LeagueWorkerMain(void *arg) {
+    LeagueWorker *worker = (LeagueWorker *)arg;
+    for (;;) {
+        int row = -1;
+        pthread_mutex_lock(&worker->lock);
+        if (worker->next < worker->end)
+            row = worker->next++;
+        pthread_mutex_unlock(&worker->lock);
+        if (row >= 0)
+            PlayLeagueRow(worker, row);
+        else if (!StealRows(worker))
+            break; //nothing queued anywhere, and rows never get added back
+    }
+    return NULL;
+}
+
+static void *LeagueAlloc(size_t count, size_t size) {
+    void *memory = calloc(count == 0 ? 1 : count, size);
+    if (memory == NULL) {
+        fputs("Memory allocation failed.\n", stderr);
+        exit(1);
+    }
+    return memory;
+}
+
+void PlayLeague(League *league) {
+    //row r costs (lineups - 1 - r) matches: cut the triangle into equal-work ranges
+    long long total = (long long)league->lineups * (league->lineups - 1) / 2, done = 0;
+    int row = 0;
+    for (int w = 0; w < league->threads; w++) {
+        LeagueWorker *worker = &league->workers[w];
+        long long target = total * (w + 1) / league->threads;
+        worker->next = row;
+        while (row < league->lineups && (done < target || w == league->threads - 1)) {
+            done += league->lineups - 1 - row;
+            row++;
+        }
+        worker->end = row;
+    }
+    int *started = (int *)LeagueAlloc((size_t)league->threads, sizeof(int));
+    for (int w = 1; w < league->threads; w++) //a worker that fails to start just gets its rows stolen
+        started[w] = pthread_create(&league->workers[w].thread, NULL, LeagueWorkerMain, &league->workers[w]) == 0;
+    LeagueWorkerMain(&league->workers[0]); //the calling thread is worker 0
+    for (int w = 1; w < league->threads; w++) {
+        if (started[w])
+            pthread_join(league->workers[w].thread, NULL);
+    }
+    free(started);
+}
+
+static int CompareLineups(const void *a, const void *b) {
+    const LineupKey *first = (const LineupKey *)a, *second = (const LineupKey *)b;
+    int cmp = memcmp(first->row, second->row, sizeof(int16_t) * (size_t)first->games); //any fixed order works, it only groups equal rows
+    if (cmp != 0)
+        return cmp;
+    return (first->owner > second->owner) - (first->owner < second->owner);
+}
+
+static int CompareStandings(const void *a, const void *b) {
+    const StandingKey *first = (const StandingKey *)a, *second = (const StandingKey *)b;
+    if (first->points != second->points)
+        return first->points < second->points ? 1 : -1;
+    if (first->wins != second->wins)
+        return first->wins < second->wins ? 1 : -1;
+    return (first->owner > second->owner) - (first->owner < second->owner); //list order, so the table is the same every run
+}
+
+void RunLeague(Session *session, int games, int threads) {
+    int count = OwnerCount(session);
+    if (count < 2) {
+        OutStr(session, "Not enough owners for a league.\n");
+        return;
+    }
+    OwnerNode **owners = (OwnerNode **)LeagueAlloc((size_t)count, sizeof(OwnerNode *));
+    int16_t *rows = (int16_t *)LeagueAlloc((size_t)count * games, sizeof(int16_t));
+    int *order = (int *)LeagueAlloc((size_t)count, sizeof(int));
+    int *lineupOf = (int *)LeagueAlloc((size_t)count, sizeof(int));
+    OwnerNode *owner = session->registry->ownerHead;
+    for (int i = 0; i < count; i++, owner = owner->next) {
+        owners[i] = owner;
+        OwnerLineup(owner, games, rows + (size_t)i * games);
+        order[i] = i;
+    }
+    LineupKey *lineupKeys = (LineupKey *)LeagueAlloc((size_t)count, sizeof(LineupKey));
+    for (int i = 0; i < count; i++) {
+        lineupKeys[i].row = rows + (size_t)i * games;
+        lineupKeys[i].games = games;
+        lineupKeys[i].owner = i;
+    }
+    qsort(lineupKeys, (size_t)count, sizeof(LineupKey), CompareLineups);
+    for (int i = 0; i < count; i++)
+        order[i] = lineupKeys[i].owner;
+    free(lineupKeys);
+
+    League league;
+    league.games = games;
+    league.lineups = 0;
+    for (int i = 0; i < count; i++) { //equal rows are next to each other now
+        if (i == 0 || memcmp(rows + (size_t)order[i - 1] * games, rows + (size_t)order[i] * games,
+                             sizeof(int16_t) * (size_t)games) != 0)
+            league.lineups++;
+        lineupOf[order[i]] = league.lineups - 1;
+    }
+    league.top = (int16_t *)LeagueAlloc((size_t)games * league.lineups, sizeof(int16_t));
+    league.members = (int *)LeagueAlloc((size_t)league.lineups, sizeof(int));
+    for (int i = 0; i < count; i++) {
+        int lineup = lineupOf[i];
+        if (league.members[lineup]++ == 0) {
+            for (int g = 0; g < games; g++)
+                league.top[(size_t)g * league.lineups + lineup] = rows[(size_t)i * games + g];
+        }
+    }
+
+    threads = ResolveThreads(threads, league.lineups - 1); //rows with at least one match
+    league.threads = threads;
+    league.workers = (LeagueWorker *)LeagueAlloc((size_t)threads, sizeof(LeagueWorker));
+    for (int w = 0; w < threads; w++) {
+        LeagueWorker *worker = &league.workers[w];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->wins = (int *)LeagueAlloc((size_t)league.lineups, sizeof(int));
+        worker->draws = (int *)LeagueAlloc((size_t)league.lineups, sizeof(int));
+        worker->losses = (int *)LeagueAlloc((size_t)league.lineups, sizeof(int));
+        worker->diff = (int16_t *)LeagueAlloc((size_t)league.lineups, sizeof(int16_t));
+        worker->league = &league;
+    }
+    PlayLeague(&league);
+
+    long long *wins = (long long *)LeagueAlloc((size_t)league.lineups, sizeof(long long));
+    long long *draws = (long long *)LeagueAlloc((size_t)league.lineups, sizeof(long long));
+    long long *losses = (long long *)LeagueAlloc((size_t)league.lineups, sizeof(long long));
+    for (int w = 0; w < threads; w++) { //integer sums: same totals whoever played which row
+        LeagueWorker *worker = &league.workers[w];
+        for (int l = 0; l < league.lineups; l++) {
+            wins[l] += worker->wins[l];
+            draws[l] += worker->draws[l];
+            losses[l] += worker->losses[l];
+        }
+        pthread_mutex_destroy(&worker->lock);
+        free(worker->wins);
+        free(worker->draws);
+        free(worker->losses);
+        free(worker->diff);
+    }
+    free(league.workers);
+
+    StandingKey *standings = (StandingKey *)LeagueAlloc((size_t)count, sizeof(StandingKey));
+    for (int i = 0; i < count; i++) {
+        int lineup = lineupOf[i];
+        long long drawn = draws[lineup] + league.members[lineup] - 1; //same lineup => every game equal
+        standings[i].wins = wins[lineup];
+        standings[i].points = 3 * wins[lineup] + drawn;
+        standings[i].owner = i;
+    }
+    qsort(standings, (size_t)count, sizeof(StandingKey), CompareStandings);
+    OutPrintf(session, "League: %d owners, best of %d, %lld matches.\n", count, games, (long long)count * (count - 1) / 2);
+    for (int r = 0; r < count; r++) {
+        int i = standings[r].owner;
+        int lineup = lineupOf[i];
+        OutInt(session, r + 1);
+        OutStr(session, ". ");
+        OutStr(session, owners[i]->ownerName);
+        OutStr(session, " - W: ");
+        OutInt(session, (int)wins[lineup]);
+        OutStr(session, " D: ");
+        OutInt(session, (int)(draws[lineup] + league.members[lineup] - 1));
+        OutStr(session, " L: ");
+        OutInt(session, (int)losses[lineup]);
+        OutStr(session, ", Points: ");
+        OutInt(session, (int)standings[r].points);
+        OutChar(session, '\n');
+    }
+    free(standings);
+    free(wins);
+    free(draws);
+    free(losses);
+    free(league.top);
+    free(league.members);
+    free(owners);
+    free(rows);
+    free(order);
+    free(lineupOf);
+}
+
+void LeagueMenu(Session *session) {
+    if (OwnerCount(session) < 2) {
+        OutStr(session, "Not enough owners for a league.\n");
+        return;
+    }
+    OutPrompt(session, "Best of how many games (1-151): ");
+    int games = readIntSafe(session, "");
+    while (games < 1 || games > LEAGUE_MAX_GAMES) {
+        OutStr(session, "Invalid choice.\n");
+        games = readIntSafe(session, "");
+    }
+    RunLeague(session, games, session->threads);
+}
+
+int ResolveThreads(int requested, int work) {
+    int threads = requested > 0 ? requested : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > work) //more workers than work would just sit there
+        threads = work;
+    return threads < 1 ? 1 : threads;
+}
+
+void *BulkMergeWorker(void *arg) {
+    BulkMerge *merge = (BulkMerge *)arg;
+    for (;;) {
+        pthread_mutex_lock(&merge->lock);
+        int pair = merge->nextPair++;
+        pthread_mutex_unlock(&merge->lock);
+        int first = pair * 2 * merge->stride;
+        if (first + merge->stride >= merge->count)
+            break; //this level is done
+        MergeTrees(merge->session, merge->owners[first], merge->owners[first + merge->stride]);
+    }
+    return NULL;
+}
+
+void MergeOwners(Session *session, OwnerNode **owners, int count, int threads) {
+    BulkMerge merge;
+    merge.session = session;
+    merge.owners = owners;
+    merge.count = count;
+    pthread_mutex_init(&merge.lock, NULL);
+    pthread_t workers[64];
+    for (merge.stride = 1; merge.stride < count; merge.stride *= 2) {
+        int pairs = (count - merge.stride + 2 * merge.stride - 1) / (2 * merge.stride);
+        int levelThreads = ResolveThreads(threads, pairs);
+        if (levelThreads > 64)
+            levelThreads = 64;
+        merge.nextPair = 0;
+        int started = 0;
+        for (int t = 1; t < levelThreads; t++) { //whatever doesn't start, the others pick up
+            if (pthread_create(&workers[started], NULL, BulkMergeWorker, &merge) == 0)
+                started++;
+        }
+        BulkMergeWorker(&merge);
+        for (int t = 0; t < started; t++)
+            pthread_join(workers[t], NULL); //every pair of this level is done before the next one reads it
+    }
+    pthread_mutex_destroy(&merge.lock);
+}
+
+void MergeManyMenu(Session *session) {
+    int total = OwnerCount(session);
+    if (total < 2) {
+        OutStr(session, "Not enough owners to merge.\n");
+        return;
+    }
+    OutPrompt(session, "\n=== Merge Many Pokedexes ===\n");
+    OutPrompt(session, "How many owners: ");
+    int count = readIntSafe(session, "");
+    while (count < 2 || count > total) {
+        OutStr(session, "Invalid choice.\n");
+        count = readIntSafe(session, "");
+    }
+    //in the session, not a local: if the input ends during the names, ShutdownProgram frees it
+    OwnerNode **owners = session->ownerNames = (OwnerNode **)malloc(sizeof(OwnerNode *) * (size_t)count);
+    if (owners == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    int named = 0, missing = 0;
+    for (int i = 0; i < count; i++) {
+        OutPrompt(session, "Enter name of owner: ");
+        OwnerNode *owner = FindOwnerByName(session, getDynamicInput(session)); //the name is gone after the next read
+        if (owner == NULL) {
+            missing = 1; //keep reading so the script stays in step
+            continue;
+        }
+        owners[named++] = owner;
+    }
+    session->ownerNames = NULL;
+    unsigned char *listed = (unsigned char *)calloc((size_t)session->registry->ownerDirectory.used + 1, 1); //by directory slot
+    if (listed == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    int found = 0;
+    for (int i = 0; i < named; i++) {
+        if (!listed[owners[i]->slot]) { //listing someone twice changes nothing
+            listed[owners[i]->slot] = 1;
+            owners[found++] = owners[i];
+        }
+    }
+    free(listed);
+    if (missing) {
+        OutStr(session, "Owner not found.\n");
+        free(owners);
+        return;
+    }
+    if (found < 2) {
+        OutStr(session, "Not enough owners to merge.\n");
+        free(owners);
+        return;
+    }
+    OutStr(session, "Merging ");
+    for (int i = 0; i < found; i++) {
+        OutStr(session, owners[i]->ownerName);
+        OutStr(session, i + 1 < found ? ", " : "...\n");
+    }
+    MergeOwners(session, owners, found, session->threads);
+    OutStr(session, "Merge completed.\n");
+    for (int i = 1; i < found; i++) { //one pass over the absorbed owners, all of them empty now
+        OutPrintf(session, "Owner '%s' has been removed after merging.\n", owners[i]->ownerName);
+        JournalLog(session, JOURNAL_MERGE, 0, owners[0]->ownerName, owners[i]->ownerName); //replays as k-1 pair merges, same union
+        FreeOwnerNode(session, owners[i]);
+    }
+    free(owners);
+}
+
+// --------------------------------------------------------------
+// 12d) Server
+// --------------------------------------------------------------
+
+int SplitWords(char *line, char **words, int max) {
+    int count = 0;
+    while (*line != '\0') {
+        while (*line == ' ' || *line == '\t' || *line == '\r')
+            *line++ = '\0';
+        if (*line == '\0')
+            break;
+        if (count == max)
+            return max + 1; //too many, the caller says so
+        words[count++] = line;
+        while (*line != '\0' && *line != ' ' && *line != '\t' && *line != '\r')
+            line++;
+    }
+    return count;
+}
+
+//owner commands: look the owner up under the registry read lock, then lock just its shard
+static void ServeOwnerCommand(Server *server, Session *session, char **words, int count) {
+    const char *command = words[0];
+    int ids[2] = {0, 0};
+    int needed = strcmp(command, "display") == 0 ? 1 : strcmp(command, "fight") == 0 ? 2 : 1;
+    if (count != 2 + needed) {
+        OutStr(session, "Invalid command.\n");
+        return;
+    }
+    TraversalOrder order = ORDER_BFS;
+    int alphabetical = 0;
+    if (strcmp(command, "display") == 0) {
+        const char *how = words[2];
+        if (strcmp(how, "bfs") == 0)
+            order = ORDER_BFS;
+        else if (strcmp(how, "pre") == 0)
+            order = ORDER_PRE;
+        else if (strcmp(how, "in") == 0)
+            order = ORDER_IN;
+        else if (strcmp(how, "post") == 0)
+            order = ORDER_POST;
+        else if (strcmp(how, "alpha") == 0)
+            alphabetical = 1;
+        else {
+            OutStr(session, "Invalid choice.\n");
+            return;
+        }
+    }
+    else {
+        for (int i = 0; i < needed; i++) {
+            if (!ParseIntLine(words[2 + i], &ids[i])) {
+                OutStr(session, "Invalid input.\n");
+                return;
+            }
+        }
+    }
+    int writes = strcmp(command, "display") != 0 && strcmp(command, "fight") != 0;
+    pthread_rwlock_rdlock(&server->registryLock);
+    OwnerNode *owner = FindOwnerByName(session, words[1]);
+    if (owner == NULL) {
+        pthread_rwlock_unlock(&server->registryLock);
+        OutStr(session, "Owner not found.\n");
+        return;
+    }
+    pthread_rwlock_t *shard = &server->shardLocks[owner->slot % SERVER_SHARDS]; //slots only move under the write lock
+    if (writes)
+        pthread_rwlock_wrlock(shard);
+    else
+        pthread_rwlock_rdlock(shard);
+    if (strcmp(command, "display") == 0) {
+        if (OwnerPokemonCount(owner) == 0)
+            OutStr(session, "Pokedex is empty.\n");
+        else if (alphabetical)
+            DisplayPokedexAlphabetical(session, owner);
+        else
+            DisplayPokedex(session, owner, order);
+    }
+    else if (strcmp(command, "fight") == 0) {
+        if (OwnerPokemonCount(owner) == 0)
+            OutStr(session, "Pokedex is empty.\n");
+        else
+            FightPokemon(session, owner, ids[0], ids[1]);
+    }
+    else if (strcmp(command, "add") == 0) {
+        AddPokemonId(session, owner, ids[0]);
+    }
+    else if (strcmp(command, "release") == 0) {
+        if (OwnerPokemonCount(owner) == 0)
+            OutStr(session, "No Pokemon to release.\n");
+        else
+            ReleasePokemonId(session, owner, ids[0]);
+    }
+    else { //evolve
+        if (OwnerPokemonCount(owner) == 0)
+            OutStr(session, "Cannot evolve. Pokedex empty.\n");
+        else
+            EvolvePokemonId(session, owner, ids[0]);
+    }
+    pthread_rwlock_unlock(shard);
+    pthread_rwlock_unlock(&server->registryLock);
+}
+
+//commands that add, remove or reorder owners: the whole registry, nobody else in it
+static void ServeRegistryCommand(Server *server, Session *session, char **words, int count) {
+    const char *command = words[0];
+    int oneName = strcmp(command, "delete") == 0 || strcmp(command, "save") == 0 || strcmp(command, "load") == 0
+                  || strcmp(command, "checkpoint") == 0;
+    if (strcmp(command, "sort") == 0 ? count != 1 : oneName ? count != 2 : count != 3) {
+        OutStr(session, "Invalid command.\n");
+        return;
+    }
+    int starter = 0;
+    if (strcmp(command, "new") == 0) {
+        int choice;
+        if (!ParseIntLine(words[2], &choice) || (starter = StarterId(choice)) == 0) {
+            OutStr(session, "Invalid choice.\n");
+            return;
+        }
+    }
+    pthread_rwlock_wrlock(&server->registryLock);
+    if (strcmp(command, "new") == 0) {
+        NewOwner(session, words[1], starter);
+    }
+    else if (strcmp(command, "sort") == 0) {
+        SortOwners(session);
+    }
+    else if (strcmp(command, "save") == 0) { //write lock: nobody may change a Pokedex halfway through
+        SaveSnapshot(session, words[1]);
+    }
+    else if (strcmp(command, "load") == 0) {
+        LoadSnapshot(session, words[1]);
+    }
+    else if (strcmp(command, "checkpoint") == 0) { //write lock only for the fork, the child writes on its own
+        CheckpointCommand(session, words[1]);
+    }
+    else if (strcmp(command, "delete") == 0) {
+        OwnerNode *owner = FindOwnerByName(session, words[1]);
+        if (owner == NULL)
+            OutStr(session, "Owner not found.\n");
+        else
+            DeleteOwner(session, owner);
+    }
+    else if (strcmp(command, "clone") == 0) {
+        OwnerNode *owner = FindOwnerByName(session, words[1]);
+        if (owner == NULL)
+            OutStr(session, "Owner not found.\n");
+        else
+            CloneOwner(session, owner, words[2]);
+    }
+    else { //merge
+        OwnerNode *first = FindOwnerByName(session, words[1]);
+        OwnerNode *second = FindOwnerByName(session, words[2]);
+        if (first == NULL || second == NULL)
+            OutStr(session, "Owner not found.\n");
+        else if (first == second)
+            OutStr(session, "Cannot merge an owner with itself.\n");
+        else
+            MergeOwnerPair(session, first, second, words[2]);
+    }
+    pthread_rwlock_unlock(&server->registryLock);
+}
+
+//preview NAME NAME only reads: the registry and both owners' shards shared, in shard order so two can't deadlock
+static void ServePreview(Server *server, Session *session, char **words, int count) {
+    if (count != 3) {
+        OutStr(session, "Invalid command.\n");
+        return;
+    }
+    pthread_rwlock_rdlock(&server->registryLock);
+    OwnerNode *first = FindOwnerByName(session, words[1]);
+    OwnerNode *second = FindOwnerByName(session, words[2]);
+    if (first == NULL || second == NULL) {
+        pthread_rwlock_unlock(&server->registryLock);
+        OutStr(session, "Owner not found.\n");
+        return;
+    }
+    int low = first->slot % SERVER_SHARDS;
+    int high = second->slot % SERVER_SHARDS;
+    if (low > high) {
+        int temp = low;
+        low = high;
+        high = temp;
+    }
+    pthread_rwlock_rdlock(&server->shardLocks[low]);
+    if (high != low)
+        pthread_rwlock_rdlock(&server->shardLocks[high]);
+    PreviewMerge(session, first, second);
+    if (high != low)
+        pthread_rwlock_unlock(&server->shardLocks[high]);
+    pthread_rwlock_unlock(&server->shardLocks[low]);
+    pthread_rwlock_unlock(&server->registryLock);
+}
+
+int ServeRequest(Server *server, Session *session, char *line) {
+    char *words[4]; //"fight NAME ID ID" is the longest
+    int count = SplitWords(line, words, 4);
+    if (count == 0)
+        return 1; //empty line, empty answer
+    const char *command = words[0];
+    if (count > 4) {
+        OutStr(session, "Invalid command.\n");
+    }
+    else if (strcmp(command, "quit") == 0) {
+        return 0;
+    }
+    else if (strcmp(command, "shutdown") == 0) {
+        pthread_mutex_lock(&server->queueLock);
+        server->stopping = 1;
+        pthread_mutex_unlock(&server->queueLock);
+        OutStr(session, "Goodbye!\n");
+        return 0;
+    }
+    else if (strcmp(command, "owners") == 0 || strcmp(command, "print") == 0) { //read-only, whole list
+        pthread_rwlock_rdlock(&server->registryLock);
+        int num;
+        if (strcmp(command, "owners") == 0) {
+            if (OwnerCount(session) == 0)
+                OutStr(session, "No existing Pokedexes.\n");
+            else
+                PrintOwnerList(session);
+        }
+        else if (count != 3 || (strcmp(words[1], "F") != 0 && strcmp(words[1], "B") != 0)
+                 || !ParseIntLine(words[2], &num)) {
+            OutStr(session, "Invalid command.\n");
+        }
+        else {
+            PrintOwnersDirection(session, words[1][0] == 'F', num);
+        }
+        pthread_rwlock_unlock(&server->registryLock);
+    }
+    else if (strcmp(command, "display") == 0 || strcmp(command, "fight") == 0 || strcmp(command, "add") == 0
+             || strcmp(command, "release") == 0 || strcmp(command, "evolve") == 0) {
+        ServeOwnerCommand(server, session, words, count);
+    }
+    else if (strcmp(command, "new") == 0 || strcmp(command, "delete") == 0 || strcmp(command, "merge") == 0
+             || strcmp(command, "sort") == 0 || strcmp(command, "save") == 0 || strcmp(command, "load") == 0
+             || strcmp(command, "checkpoint") == 0 || strcmp(command, "clone") == 0) {
+        ServeRegistryCommand(server, session, words, count);
+    }
+    else if (strcmp(command, "preview") == 0) {
+        ServePreview(server, session, words, count);
+    }
+    else {
+        OutStr(session, "Invalid command.\n");
+    }
+    return 1;
+}
+
+static void WakeServer(Server *server) {
+    char poke = 1;
+    while (write(server->wakeFds[1], &poke, 1) < 0 && errno == EINTR)
+        ; //a full pipe is fine too, the loop is awake already
+}
+
+//queue lock held: hand the client to the workers
+static void QueueClient(Server *server, ServerClient *client) {
+    client->busy = 1;
+    client->nextQueued = NULL;
+    if (server->queueTail != NULL)
+        server->queueTail->nextQueued = client;
+    else
+        server->queueHead = client;
+    server->queueTail = client;
+    pthread_cond_signal(&server->queueReady);
+}
+
+void *ServerWorker(void *arg) {
+    Server *server = (Server *)arg;
+    Session session; //~70KB: this worker's output buffer, the owners are the server's
+    InitSession(&session, &server->registry, -1, -1);
+    session.output.batch = 1; //no menus here, just results
+    session.threads = 1;
+    for (;;) {
+        pthread_mutex_lock(&server->queueLock);
+        while (server->queueHead == NULL && !server->stopping)
+            pthread_cond_wait(&server->queueReady, &server->queueLock);
+        ServerClient *client = server->queueHead;
+        if (client == NULL) { //stopping and nothing left
+            pthread_mutex_unlock(&server->queueLock);
+            break;
+        }
+        server->queueHead = client->nextQueued;
+        if (server->queueHead == NULL)
+            server->queueTail = NULL;
+        pthread_mutex_unlock(&server->queueLock);
+
+        //busy: the loop leaves client->pending alone until we hand it back
+        char *newline = (char *)memchr(client->pending, '\n', client->length);
+        size_t used = (size_t)(newline - client->pending) + 1;
+        *newline = '\0';
+        session.output.fd = client->fd;
+        uint64_t logged = session.journalSequence;
+        double started = NowSeconds();
+        int keepOpen = ServeRequest(server, &session, client->pending);
+        Journal *journal = server->registry.journal;
+        if (journal != NULL && session.journalSequence != logged) //durable before the client hears about it
+            JournalCommit(journal, session.journalSequence);
+        NoteCommandLatency(&server->registry, NowSeconds() - started);
+        if (session.output.length > 0 && session.output.data[session.output.length - 1] != '\n')
+            OutChar(&session, '\n'); //a few messages never had their '\n'
+        OutStr(&session, ".\n"); //end of this answer
+        OutFlush(&session);
+        FinishCheckpoint(&session, 0); //no owner is touched, no lock needed
+        if (journal != NULL && JournalWantsCompaction(journal) && !CheckpointRunning(&server->registry)) {
+            pthread_rwlock_wrlock(&server->registryLock);
+            if (JournalWantsCompaction(journal)) //another worker may have just done it
+                CompactJournal(&session, 1); //only the fork happens under the lock
+            pthread_rwlock_unlock(&server->registryLock);
+        }
+        memmove(client->pending, client->pending + used, client->length - used);
+        client->length -= used;
+
+        pthread_mutex_lock(&server->queueLock);
+        if (!keepOpen)
+            client->hungUp = 1;
+        int idle = 1;
+        if (!client->hungUp && memchr(client->pending, '\n', client->length) != NULL) {
+            QueueClient(server, client); //pipelined: next line, same order, back of the queue
+            idle = 0;
+        }
+        else {
+            client->busy = 0;
+        }
+        pthread_mutex_unlock(&server->queueLock);
+        if (idle)
+            WakeServer(server); //poll() this client again (or close it)
+    }
+    return NULL;
+}
+
+static void DropClient(Server *server, int index) {
+    ServerClient *client = server->clients[index];
+    close(client->fd);
+    free(client->pending);
+    free(client);
+    server->clients[index] = server->clients[--server->clientCount];
+}
+
+//bytes arrived (or the peer left): 0 once the client should be dropped
+static int ReadClient(Server *server, ServerClient *client) {
+    if (client->capacity - client->length < 1024) {
+        if (client->capacity >= SERVER_MAX_PENDING)
+            return 0; //a line that never ends, or far too much pipelined: not a client we want
+        size_t capacity = client->capacity == 0 ? 4096 : client->capacity * 2;
+        char *bigger = (char *)realloc(client->pending, capacity);
+        if (bigger == NULL)
+            return 0;
+        client->pending = bigger;
+        client->capacity = capacity;
+    }
+    ssize_t n = read(client->fd, client->pending + client->length, client->capacity - client->length);
+    if (n < 0 && errno == EINTR)
+        return 1;
+    if (n <= 0)
+        client->hungUp = 1;
+    else
+        client->length += (size_t)n;
+    pthread_mutex_lock(&server->queueLock);
+    if (memchr(client->pending, '\n', client->length) != NULL)
+        QueueClient(server, client);
+    int keep = !client->hungUp || client->busy; //gone, but its last lines still get answered
+    pthread_mutex_unlock(&server->queueLock);
+    return keep;
+}
+
+static int SocketAddress(const char *path, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return 0;
+    }
+    strcpy(address->sun_path, path);
+    return 1;
+}
+
+int RunServer(const char *path, int threads) {
+    struct sockaddr_un address;
+    if (!SocketAddress(path, &address))
+        return 1;
+    Server *server = (Server *)calloc(1, sizeof(Server));
+    if (server == NULL) {
+        fputs("Memory allocation failed.\n", stderr);
+        return 1;
+    }
+    server->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path); //a socket file left behind by an earlier run
+    if (server->listenFd < 0 || bind(server->listenFd, (struct sockaddr *)&address, sizeof(address)) != 0
+        || listen(server->listenFd, SOMAXCONN) != 0 || pipe(server->wakeFds) != 0) {
+        perror(path);
+        free(server);
+        return 1;
+    }
+    fcntl(server->wakeFds[0], F_SETFL, O_NONBLOCK); //drained without blocking,
+    fcntl(server->wakeFds[1], F_SETFL, O_NONBLOCK); //and a full pipe never stalls a worker
+    signal(SIGPIPE, SIG_IGN); //a client that leaves mid-answer is a failed write(), not the end of the server
+    InitRegistry(&server->registry);
+    if (journalFile != NULL) {
+        Session setup; //recovery builds the owners with the usual functions
+        InitSession(&setup, &server->registry, -1, STDOUT_FILENO);
+        if (!OpenJournal(&setup, journalFile)) {
+            close(server->listenFd);
+            close(server->wakeFds[0]);
+            close(server->wakeFds[1]);
+            unlink(path);
+            ShutdownProgram(&setup);
+            free(server);
+            return 1;
+        }
+    }
+    pthread_rwlock_init(&server->registryLock, NULL);
+    for (int i = 0; i < SERVER_SHARDS; i++)
+        pthread_rwlock_init(&server->shardLocks[i], NULL);
+    pthread_mutex_init(&server->queueLock, NULL);
+    pthread_cond_init(&server->queueReady, NULL);
+    server->threads = ResolveThreads(threads, SERVER_MAX_WORKERS);
+    server->workers = (pthread_t *)malloc(sizeof(pthread_t) * (size_t)server->threads);
+    int started = 0;
+    for (int t = 0; server->workers != NULL && t < server->threads; t++) {
+        if (pthread_create(&server->workers[started], NULL, ServerWorker, server) == 0)
+            started++;
+    }
+    if (started == 0) {
+        fputs("Could not start the server workers.\n", stderr);
+        server->stopping = 1;
+    }
+
+    struct pollfd *polls = NULL;
+    ServerClient **polled = NULL; //which client each polls[] entry is (NULL for the listener and the pipe)
+    int pollCapacity = 0;
+    for (;;) {
+        if (pollCapacity < server->clientCount + 2) {
+            pollCapacity = (server->clientCount + 2) * 2;
+            struct pollfd *morePolls = (struct pollfd *)realloc(polls, sizeof(struct pollfd) * (size_t)pollCapacity);
+            ServerClient **morePolled = (ServerClient **)realloc(polled, sizeof(ServerClient *) * (size_t)pollCapacity);
+            if (morePolls == NULL || morePolled == NULL) {
+                fputs("Memory allocation failed.\n", stderr);
+                exit(1);
+            }
+            polls = morePolls;
+            polled = morePolled;
+        }
+        int count = 0;
+        polls[count].fd = server->listenFd;
+        polls[count].events = POLLIN;
+        polled[count++] = NULL;
+        polls[count].fd = server->wakeFds[0];
+        polls[count].events = POLLIN;
+        polled[count++] = NULL;
+        pthread_mutex_lock(&server->queueLock);
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->queueLock);
+            break;
+        }
+        for (int i = 0; i < server->clientCount; i++) {
+            ServerClient *client = server->clients[i];
+            if (client->busy)
+                continue; //a worker has it, its next line waits until the answer is out
+            if (client->hungUp) { //idle and gone: nothing more will come
+                DropClient(server, i--);
+                continue;
+            }
+            polls[count].fd = client->fd;
+            polls[count].events = POLLIN;
+            polled[count++] = client;
+        }
+        pthread_mutex_unlock(&server->queueLock);
+        if (poll(polls, (nfds_t)count, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+        if (polls[1].revents & POLLIN) {
+            char drain[256];
+            while (read(server->wakeFds[0], drain, sizeof(drain)) > 0)
+                ; //one poke or many, same thing: rebuild the poll set
+        }
+        if (polls[0].revents & POLLIN) {
+            int fd = accept(server->listenFd, NULL, NULL);
+            if (fd >= 0) {
+                if (server->clientCount == server->clientCapacity) {
+                    int capacity = server->clientCapacity * 2 + 16;
+                    ServerClient **more = (ServerClient **)realloc(server->clients, sizeof(ServerClient *) * (size_t)capacity);
+                    if (more == NULL) {
+                        fputs("Memory allocation failed.\n", stderr);
+                        exit(1);
+                    }
+                    server->clients = more;
+                    server->clientCapacity = capacity;
+                }
+                ServerClient *client = (ServerClient *)calloc(1, sizeof(ServerClient));
+                if (client == NULL) {
+                    fputs("Memory allocation failed.\n", stderr);
+                    exit(1);
+                }
+                client->fd = fd;
+                server->clients[server->clientCount++] = client;
+            }
+        }
+        for (int p = 2; p < count; p++) {
+            if (polls[p].revents == 0)
+                continue;
+            ServerClient *client = polled[p];
+            if (!ReadClient(server, client)) {
+                for (int i = 0; i < server->clientCount; i++) {
+                    if (server->clients[i] == client) {
+                        DropClient(server, i);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    pthread_mutex_lock(&server->queueLock); //workers finish what's queued, then see stopping
+    server->stopping = 1;
+    pthread_cond_broadcast(&server->queueReady);
+    pthread_mutex_unlock(&server->queueLock);
+    for (int t = 0; t < started; t++)
+        pthread_join(server->workers[t], NULL);
+    while (server->clientCount > 0)
+        DropClient(server, server->clientCount - 1);
+    free(server->clients);
+    free(server->workers);
+    free(polls);
+    free(polled);
+    close(server->listenFd);
+    close(server->wakeFds[0]);
+    close(server->wakeFds[1]);
+    unlink(path);
+
+    Session session; //just to free the owners with the usual functions
+    InitSession(&session, &server->registry, -1, STDOUT_FILENO);
+    ShutdownProgram(&session);
+    for (int i = 0; i < SERVER_SHARDS; i++)
+        pthread_rwlock_destroy(&server->shardLocks[i]);
+    pthread_rwlock_destroy(&server->registryLock);
+    pthread_mutex_destroy(&server->queueLock);
+    pthread_cond_destroy(&server->queueReady);
+    free(server);
+    return 0;
+}
+
+// --------------------------------------------------------------
+// 12e) Load Generator
+// --------------------------------------------------------------
+
+double NowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+//send one line, read until the ".\n" that ends its answer; 0 if the server went away
+static int LoadRequest(LoadClient *client, const char *line) {
+    size_t length = strlen(line), sent = 0;
+    while (sent < length) {
+        ssize_t n = write(client->fd, line + sent, length - sent);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        sent += (size_t)n;
+    }
+    size_t have = 0;
+    for (;;) {
+        if (have == sizeof(client->reply)) { //only the tail matters, keep the last two bytes
+            client->reply[0] = client->reply[have - 2];
+            client->reply[1] = client->reply[have - 1];
+            have = 2;
+        }
+        ssize_t n = read(client->fd, client->reply + have, sizeof(client->reply) - have);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        have += (size_t)n;
+        if ((have == 2 && client->reply[0] == '.' && client->reply[1] == '\n')
+            || (have >= 3 && memcmp(client->reply + have - 3, "\n.\n", 3) == 0))
+            return 1;
+    }
+}
+
+void *LoadClientMain(void *arg) {
+    LoadClient *client = (LoadClient *)arg;
+    char line[64], name[32];
+    snprintf(name, sizeof(name), "load%d", client->id);
+    struct sockaddr_un address;
+    SocketAddress(client->path, &address); //RunLoad already checked the length
+    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror(client->path);
+        if (client->fd >= 0)
+            close(client->fd);
+        return NULL;
+    }
+    snprintf(line, sizeof(line), "new %s 1\n", name); //its own owner, so writers mostly hit different shards
+    LoadRequest(client, line);
+    unsigned int seed = (unsigned int)client->id * 2654435761u + 1;
+    for (client->done = 0; client->done < client->requests; client->done++) {
+        seed = seed * 1103515245u + 12345u; //a cheap LCG is plenty to pick commands
+        int pick = (int)((seed >> 16) % 100);
+        int id = (int)((seed >> 8) % POKEDEX_SIZE) + 1;
+        if (pick < 40) //mostly reads, like a real Pokedex app
+            snprintf(line, sizeof(line), "display %s in\n", name);
+        else if (pick < 70)
+            snprintf(line, sizeof(line), "fight %s 1 %d\n", name, id);
+        else if (pick < 80)
+            snprintf(line, sizeof(line), "print F 10\n");
+        else if (pick < 90)
+            snprintf(line, sizeof(line), "add %s %d\n", name, id);
+        else
+            snprintf(line, sizeof(line), "release %s %d\n", name, id);
+        double start = NowSeconds();
+        if (!LoadRequest(client, line))
+            break;
+        client->latencies[client->done] = NowSeconds() - start;
+    }
+    LoadRequest(client, "quit\n");
+    close(client->fd);
+    return NULL;
+}
+
+static int CompareSeconds(const void *a, const void *b) {
+    double first = *(const double *)a, second = *(const double *)b;
+    return (first > second) - (first < second);
+}
+
+int RunLoad(const char *path, int clients, int requests) {
+    struct sockaddr_un address;
+    if (!SocketAddress(path, &address))
+        return 1;
+    signal(SIGPIPE, SIG_IGN);
+    LoadClient *load = (LoadClient *)calloc((size_t)clients, sizeof(LoadClient));
+    double *latencies = (double *)malloc(sizeof(double) * (size_t)clients * (size_t)requests);
+    if (load == NULL || latencies == NULL) {
+        fputs("Memory allocation failed.\n", stderr);
+        exit(1);
+    }
+    double start = NowSeconds();
+    for (int c = 0; c < clients; c++) {
+        load[c].id = c;
+        load[c].path = path;
+        load[c].requests = requests;
+        load[c].latencies = latencies + (size_t)c * requests;
+        load[c].started = pthread_create(&load[c].thread, NULL, LoadClientMain, &load[c]) == 0;
+    }
+    int total = 0;
+    for (int c = 0; c < clients; c++) {
+        if (load[c].started)
+            pthread_join(load[c].thread, NULL);
+        memmove(latencies + total, load[c].latencies, sizeof(double) * (size_t)load[c].done); //pack them together
+        total += load[c].done;
+    }
+    double elapsed = NowSeconds() - start;
+    if (total == 0) {
+        fprintf(stderr, "%s: no request got an answer\n", path);
+        free(load);
+        free(latencies);
+        return 1;
+    }
+    qsort(latencies, (size_t)total, sizeof(double), CompareSeconds);
+    printf("Load: %d clients, %d requests in %.3f s, %.0f requests/s\n", clients, total, elapsed, total / elapsed);
+    printf("Latency: p50 %.1f us, p99 %.1f us, max %.1f us\n", latencies[total / 2] * 1e6,
+           latencies[(size_t)((total - 1) * 0.99)] * 1e6, latencies[total - 1] * 1e6);
+    free(load);
+    free(latencies);
+    return total == clients * requests ? 0 : 1;
+}
+
+// --------------------------------------------------------------
+// 12f) Snapshots
+// --------------------------------------------------------------
+
+static void SnapshotFlush(SnapshotWriter *writer) {
+    size_t written = 0;
+    while (written < writer->length && !writer->failed) { //write() may take less than everything
+        ssize_t n = write(writer->fd, writer->data + written, writer->length - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            writer->failed = 1;
+        else
+            written += (size_t)n;
+    }
+    writer->length = 0;
+}
+
+static void SnapshotWrite(SnapshotWriter *writer, const void *data, size_t size) {
+    const char *bytes = (const char *)data;
+    while (size > 0) {
+        size_t room = sizeof(writer->data) - writer->length;
+        if (room == 0) {
+            SnapshotFlush(writer);
+            continue;
+        }
+        size_t chunk = size < room ? size : room;
+        memcpy(writer->data + writer->length, bytes, chunk);
+        writer->length += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+char *SuffixedPath(Session *session, const char *path, const char *suffix) {
+    size_t length = strlen(path);
+    size_t extra = strlen(suffix) + 1;
+    char *joined = (char *)malloc(length + extra);
+    if (joined == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    memcpy(joined, path, length);
+    memcpy(joined + length, suffix, extra);
+    return joined;
+}
+
+int WriteSnapshot(Session *session, const char *path, uint64_t journalSequence) {
+    char *tmpPath = SuffixedPath(session, path, ".tmp");
+    SnapshotWriter *writer = (SnapshotWriter *)malloc(sizeof(SnapshotWriter)); //64KB, too big for a server worker's stack
+    if (writer == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    writer->fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer->failed = writer->fd < 0;
+    writer->length = 0;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.journalSequence = journalSequence;
+    header.ownerCount = (uint64_t)OwnerCount(session);
+    header.namesOffset = sizeof(SnapshotHeader) + header.ownerCount * sizeof(SnapshotOwner);
+    if (!writer->failed) {
+        SnapshotWrite(writer, &header, sizeof(header)); //namesBytes is filled in at the end
+        OwnerNode *head = session->registry->ownerHead;
+        OwnerNode *owner = head;
+        uint64_t nameOffset = 0;
+        if (owner != NULL) {
+            do { //records first, names after, both in list order
+                SnapshotOwner record;
+                memcpy(record.owned, owner->owned, sizeof(record.owned));
+                record.nameOffset = nameOffset;
+                SnapshotWrite(writer, &record, sizeof(record));
+                nameOffset += strlen(owner->ownerName) + 1;
+                owner = owner->next;
+            } while (owner != head);
+            do {
+                SnapshotWrite(writer, owner->ownerName, strlen(owner->ownerName) + 1);
+                owner = owner->next;
+            } while (owner != head);
+        }
+        SnapshotFlush(writer);
+        header.namesBytes = nameOffset;
+        if (!writer->failed && pwrite(writer->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+            writer->failed = 1;
+        if (!writer->failed && fsync(writer->fd) != 0) //the rename must not get to disk before the data
+            writer->failed = 1;
+    }
+    if (writer->fd >= 0 && close(writer->fd) != 0)
+        writer->failed = 1;
+    int saved = !writer->failed && rename(tmpPath, path) == 0;
+    if (!saved && writer->fd >= 0)
+        unlink(tmpPath);
+    free(writer);
+    free(tmpPath);
+    return saved;
+}
+
+int SaveSnapshot(Session *session, const char *path) {
+    //with a journal the snapshot says how much of it is inside, so it can be recovered from like a compaction
+    if (WriteSnapshot(session, path, JournalNextSequence(session->registry->journal))) {
+        OutPrintf(session, "Saved %d owners to %s.\n", OwnerCount(session), path);
+        return 1;
+    }
+    OutPrintf(session, "Could not save snapshot to %s.\n", path);
+    return 0;
+}
+
+const char *CheckSnapshotHeader(const char *data, size_t size) {
+    SnapshotHeader header;
+    if (size < sizeof(header))
+        return "not a snapshot";
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+        return "not a snapshot";
+    if (header.byteOrder != SNAPSHOT_BYTE_ORDER)
+        return "written on a machine with the other byte order";
+    if (header.version != SNAPSHOT_VERSION)
+        return "unsupported version";
+    //sizes checked by division first so a huge count can't wrap the multiplication
+    if (header.ownerCount > INT_MAX || header.ownerCount > (size - sizeof(header)) / sizeof(SnapshotOwner))
+        return "truncated";
+    if (header.namesOffset != sizeof(header) + header.ownerCount * sizeof(SnapshotOwner)
+        || header.namesBytes != size - header.namesOffset)
+        return "truncated";
+    if (header.ownerCount > 0 && (header.namesBytes == 0 || data[size - 1] != '\0'))
+        return "corrupt names"; //every name ends before the end of the file
+    return NULL;
+}
+
+const char *CheckSnapshot(const char *data, size_t size) {
+    const char *problem = CheckSnapshotHeader(data, size);
+    if (problem != NULL)
+        return problem;
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    const SnapshotOwner *records = (const SnapshotOwner *)(data + sizeof(header));
+    unsigned long long extra = ~0ULL << (POKEDEX_SIZE - 64 * (POKEDEX_WORDS - 1)); //bits past the last species
+    for (uint64_t i = 0; i < header.ownerCount; i++) {
+        if (records[i].nameOffset >= header.namesBytes)
+            return "corrupt names";
+        if (records[i].owned[POKEDEX_WORDS - 1] & extra)
+            return "unknown Pokemon";
+    }
+    return NULL;
+}
+
+// the Pokedex from its bitset: IDs come out ascending, so it's BuildBalanced straight away
+static void RebuildPokedex(Session *session, OwnerNode *owner) {
+    if (pokedexLayout == LAYOUT_COMPACT) {
+        CompactRebuild(&owner->compact, owner->owned);
+        return;
+    }
+    uint8_t species[POKEDEX_SIZE];
+    PokemonNode *nodes[POKEDEX_SIZE];
+    int size = BitmapSpecies(owner->owned, species);
+    for (int i = 0; i < size; i++)
+        nodes[i] = CreatePokemonNode(session, &owner->arena, &pokedex[species[i]]);
+    owner->pokedexRoot = BuildBalanced(nodes, 0, size - 1);
+}
+
+// owners of a checked snapshot into session's (empty) registry; 0 on a duplicate name
+static int BuildFromSnapshot(Session *session, const char *data) {
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    const SnapshotOwner *records = (const SnapshotOwner *)(data + sizeof(header));
+    const char *names = data + header.namesOffset;
+    int count = (int)header.ownerCount;
+    ReserveOwnerIndex(session, count); //no rehashing and no directory growth on the way
+    CompactDirectory(session, count);
+    for (int i = 0; i < count; i++) {
+        const char *name = names + records[i].nameOffset;
+        if (FindOwnerByName(session, name) != NULL)
+            return 0;
+        OwnerNode *owner = CreateOwnerNode(session, name);
+        memcpy(owner->owned, records[i].owned, sizeof(owner->owned));
+        RebuildPokedex(session, owner);
+        AddOwner(session, owner); //appends at the tail, so list order is file order
+    }
+    return 1;
+}
+
+const char *ReadSnapshot(Session *session, const char *path, uint64_t *journalSequence) {
+    const char *problem = "can't read it";
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    char *data = MAP_FAILED;
+    size_t size = 0;
+    if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        size = (size_t)info.st_size;
+        if (size == 0)
+            problem = "not a snapshot";
+        else
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0)
+        close(fd); //the mapping stays valid
+    if (data != MAP_FAILED)
+        problem = CheckSnapshot(data, size);
+    if (problem == NULL) {
+        OwnerRegistry *live = session->registry;
+        OwnerRegistry fresh; //built aside, the current owners stay untouched until it's complete
+        InitRegistry(&fresh);
+        session->registry = &fresh;
+        int built = BuildFromSnapshot(session, data);
+        if (!built) {
+            problem = "duplicate owner name";
+            FreeAllOwners(session);
+            FreeMemoryPools(session);
+        }
+        session->registry = live;
+        if (built) { //out with the old owners, in with the new (the live registry keeps its lock and journal)
+            FreeAllOwners(session);
+            FreeMemoryPools(session);
+            live->ownerHead = fresh.ownerHead;
+            live->ownerIndex = fresh.ownerIndex;
+            live->ownerDirectory = fresh.ownerDirectory;
+            live->memoryPools.spareBlocks = fresh.memoryPools.spareBlocks;
+            live->memoryPools.ownerBlocks = fresh.memoryPools.ownerBlocks;
+            live->memoryPools.freeOwners = fresh.memoryPools.freeOwners;
+            SnapshotHeader header;
+            memcpy(&header, data, sizeof(header));
+            *journalSequence = header.journalSequence;
+        }
+        pthread_mutex_destroy(&fresh.memoryPools.spareLock);
+        pthread_mutex_destroy(&fresh.memoryPools.sharedLock);
+        pthread_mutex_destroy(&fresh.checkpoint.lock);
+    }
+    if (data != MAP_FAILED)
+        munmap(data, size);
+    return problem;
+}
+
+int LoadSnapshot(Session *session, const char *path) {
+    uint64_t journalSequence;
+    const char *problem = ReadSnapshot(session, path, &journalSequence);
+    if (problem != NULL) {
+        OutPrintf(session, "Could not load snapshot %s (%s).\n", path, problem);
+        return 0;
+    }
+    OutPrintf(session, "Loaded %d owners from %s.\n", OwnerCount(session), path);
+    if (session->registry->journal != NULL) //a whole new world can't be a journal record: it starts from here
+        CompactJournal(session, 0);
+    return 1;
+}
+
+void SaveSnapshotMenu(Session *session) {
+    OutPrompt(session, "Snapshot file: ");
+    SaveSnapshot(session, getDynamicInput(session));
+}
+
+void LoadSnapshotMenu(Session *session) {
+    OutPrompt(session, "Snapshot file: ");
+    LoadSnapshot(session, getDynamicInput(session));
+}
+
+// --------------------------------------------------------------
+// 12g) Read-only Snapshot
+// --------------------------------------------------------------
+
+int MapSnapshot(SnapshotView *view, const char *path) {
+    memset(view, 0, sizeof(*view));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct stat info;
+    const char *problem = "not a snapshot";
+    char *data = MAP_FAILED;
+    size_t size = 0;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size = (size_t)info.st_size;
+        //shared and read-only: every process on the same file reads the same cached pages.
+        //SaveSnapshot replaces files by rename, so a mapping never sees a half-written one
+        data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+            problem = strerror(errno);
+    }
+    close(fd); //the mapping stays valid
+    if (data != MAP_FAILED)
+        problem = CheckSnapshotHeader(data, size); //O(1), the records are checked as they're read
+    if (problem != NULL) {
+        if (data != MAP_FAILED)
+            munmap(data, size);
+        fprintf(stderr, "%s: %s\n", path, problem);
+        return 0;
+    }
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    view->data = data;
+    view->size = size;
+    view->owners = (const SnapshotOwner *)(data + sizeof(header));
+    view->names = data + header.namesOffset;
+    view->namesBytes = header.namesBytes;
+    view->count = (int)header.ownerCount;
+    return 1;
+}
+
+void UnmapSnapshot(SnapshotView *view) {
+    if (view->data != NULL)
+        munmap((void *)view->data, view->size);
+    memset(view, 0, sizeof(*view));
+}
+
+const char *ViewOwnerName(const SnapshotView *view, int k) {
+    uint64_t offset = view->owners[k].nameOffset;
+    return offset < view->namesBytes ? view->names + offset : "?"; //the blob's last byte is '\0', so it ends in there
+}
+
+void ViewOwned(const SnapshotView *view, int k, unsigned long long *owned) {
+    memcpy(owned, view->owners[k].owned, sizeof(view->owners[k].owned));
+    owned[POKEDEX_WORDS - 1] &= ~(~0ULL << (POKEDEX_SIZE - 64 * (POKEDEX_WORDS - 1))); //no species past the table
+}
+
+static int OwnedCount(const unsigned long long *owned) {
+    int count = 0;
+    for (int w = 0; w < POKEDEX_WORDS; w++)
+        count += CountBits(owned[w]);
+    return count;
+}
+
+//species[low..high] is sorted, so its middle one is that subtree's root (same split as BuildBalanced)
+static void PrintRangePre(Session *session, const uint8_t *species, int low, int high) {
+    if (low > high)
+        return;
+    int mid = low + (high - low) / 2;
+    PrintPokemonData(session, &pokedex[species[mid]]);
+    PrintRangePre(session, species, low, mid - 1);
+    PrintRangePre(session, species, mid + 1, high);
+}
+
+static void PrintRangePost(Session *session, const uint8_t *species, int low, int high) {
+    if (low > high)
+        return;
+    int mid = low + (high - low) / 2;
+    PrintRangePost(session, species, low, mid - 1);
+    PrintRangePost(session, species, mid + 1, high);
+    PrintPokemonData(session, &pokedex[species[mid]]);
+}
+
+void DisplayOwned(Session *session, const unsigned long long *owned, TraversalOrder order) {
+    uint8_t species[POKEDEX_SIZE];
+    int size = BitmapSpecies(owned, species); //ascending
+    switch (order) {
+    case ORDER_BFS: {
+        int lows[POKEDEX_SIZE], highs[POKEDEX_SIZE]; //FIFO of subtrees, each one is a node so size is enough
+        int head = 0, tail = 0;
+        if (size > 0) {
+            lows[tail] = 0;
+            highs[tail++] = size - 1;
+        }
+        while (head < tail) {
+            int low = lows[head], high = highs[head++];
+            int mid = low + (high - low) / 2;
+            PrintPokemonData(session, &pokedex[species[mid]]);
+            if (low < mid) {
+                lows[tail] = low;
+                highs[tail++] = mid - 1;
+            }
+            if (mid < high) {
+                lows[tail] = mid + 1;
+                highs[tail++] = high;
+            }
+        }
+        break;
+    }
+    case ORDER_PRE:
+        PrintRangePre(session, species, 0, size - 1);
+        break;
+    case ORDER_IN:
+        for (int i = 0; i < size; i++)
+            PrintPokemonData(session, &pokedex[species[i]]);
+        break;
+    case ORDER_POST:
+        PrintRangePost(session, species, 0, size - 1);
+        break;
+    }
+}
+
+void DisplayOwnedAlphabetical(Session *session, const unsigned long long *owned) {
+    uint8_t species[POKEDEX_SIZE];
+    int size = BitmapSpecies(owned, species);
+    int byName[POKEDEX_SIZE]; //species + 1 at its name rank, 0 = not owned
+    memset(byName, 0, sizeof(byName));
+    for (int i = 0; i < size; i++)
+        byName[pokedexAlphaRank[species[i] + 1]] = species[i] + 1;
+    for (int i = 0; i < POKEDEX_SIZE; i++) {
+        if (byName[i] != 0)
+            PrintPokemonData(session, &pokedex[byName[i] - 1]);
+    }
+}
+
+void ViewPrintDirection(Session *session, int forward, int num) {
+    const SnapshotView *view = session->snapshot;
+    if (view->count == 0) {
+        OutStr(session, "No owners.\n");
+        return;
+    }
+    if (num < 0) {
+        OutStr(session, "Invalid number.\n");
+        return;
+    }
+    int k = 0; //the head is the first record
+    for (int i = 0; i < num; i++) {
+        OutChar(session, '[');
+        OutInt(session, i + 1);
+        OutStr(session, "] ");
+        OutStr(session, ViewOwnerName(view, k));
+        OutChar(session, '\n');
+        if (forward)
+            k = k + 1 == view->count ? 0 : k + 1;
+        else
+            k = k == 0 ? view->count - 1 : k - 1;
+    }
+}
+
+void SnapshotDisplayMenu(Session *session, const unsigned long long *owned) {
+    if (OwnedCount(owned) == 0) {
+        OutStr(session, "Pokedex is empty.\n");
+        return;
+    }
+    OutPrompt(session, "Display:\n");
+    OutPrompt(session, "1. BFS (Level-Order)\n");
+    OutPrompt(session, "2. Pre-Order\n");
+    OutPrompt(session, "3. In-Order\n");
+    OutPrompt(session, "4. Post-Order\n");
+    OutPrompt(session, "5. Alphabetical (by name)\n");
+    int choice = readIntSafe(session, "Your choice: ");
+    switch (choice) {
+    case 1:
+        DisplayOwned(session, owned, ORDER_BFS);
+        break;
+    case 2:
+        DisplayOwned(session, owned, ORDER_PRE);
+        break;
+    case 3:
+        DisplayOwned(session, owned, ORDER_IN);
+        break;
+    case 4:
+        DisplayOwned(session, owned, ORDER_POST);
+        break;
+    case 5:
+        DisplayOwnedAlphabetical(session, owned);
+        break;
+    default:
+        OutStr(session, "Invalid choice.\n");
+    }
+}
+
+void SnapshotPokedexMenu(Session *session) {
+    const SnapshotView *view = session->snapshot;
+    if (view->count == 0) {
+        OutStr(session, "No existing Pokedexes.\n");
+        return;
+    }
+    OutPrompt(session, "\nExisting Pokedexes:\n");
+    if (!session->output.batch) {
+        for (int k = 0; k < view->count; k++) {
+            OutInt(session, k + 1);
+            OutStr(session, ". ");
+            OutStr(session, ViewOwnerName(view, k));
+            OutChar(session, '\n');
+        }
+    }
+    OutPrompt(session, "Choose a Pokedex by number: \n");
+    int choice = readIntSafe(session, "");
+    while (choice > view->count || choice < 1) {
+        OutStr(session, "Invalid choice.\n");
+        choice = readIntSafe(session, "");
+    }
+    unsigned long long owned[POKEDEX_WORDS]; //a copy: 24 bytes, and the record stays untouched
+    ViewOwned(view, choice - 1, owned);
+    const char *name = ViewOwnerName(view, choice - 1);
+    if (!session->output.batch)
+        OutPrintf(session, "Entering %s's Pokedex...", name);
+    int subChoice;
+    do {
+        if (!session->output.batch)
+            OutPrintf(session, "\n-- %s's Pokedex Menu (read-only) --\n", name);
+        OutPrompt(session, "2. Display Pokedex\n");
+        OutPrompt(session, "4. Pokemon Fight!\n");
+        OutPrompt(session, "6. Back to Main\n");
+        subChoice = readIntSafe(session, "Your choice: ");
+        switch (subChoice) {
+        case 2:
+            SnapshotDisplayMenu(session, owned);
+            break;
+        case 4:
+            if (OwnedCount(owned) == 0) {
+                OutStr(session, "Pokedex is empty.\n");
+                break;
+            }
+            OutPrompt(session, "Enter ID of the first Pokemon: ");
+            int id1 = readIntSafe(session, "");
+            OutPrompt(session, "Enter ID of the second Pokemon: ");
+            int id2 = readIntSafe(session, "");
+            FightOwned(session, owned, id1, id2);
+            break;
+        case 6:
+            OutPrompt(session, "Back to Main Menu.\n");
+            break;
+        case 1:
+        case 3:
+        case 5:
+        case 7:
+            OutStr(session, "Not available on a read-only snapshot.\n");
+            break;
+        default:
+            OutStr(session, "Invalid choice.\n");
+        }
+    } while (subChoice != 6);
+}
+
+void SnapshotMainMenu(Session *session) {
+    int choice;
+    do {
+        OutPrompt(session, "\n=== Main Menu (read-only snapshot) ===\n");
+        OutPrompt(session, "2. Existing Pokedex\n");
+        OutPrompt(session, "6. Print Owners in a direction X times\n");
+        OutPrompt(session, "7. Exit\n");
+        choice = readIntSafe(session, "Your choice: ");
+        switch (choice) {
+        case 2:
+            EnterExistingPokedexMenu(session);
+            break;
+        case 6:
+            PrintOwnersCircular(session);
+            break;
+        case 7:
+            OutPrompt(session, "Goodbye!\n");
+            break;
+        case 1:
+        case 3:
+        case 4:
+        case 5:
+        case 8:
+        case 9:
+        case 10:
+        case 11:
+        case 12:
+        case 13:
+        case 14:
+            OutStr(session, "Not available on a read-only snapshot.\n");
+            break;
+        default:
+            OutStr(session, "Invalid.\n");
+        }
+    } while (choice != 7);
+}
+
+// --------------------------------------------------------------
+// 12h) Journal
+// --------------------------------------------------------------
+
+static uint32_t JournalHash(uint32_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data; //NULL with size 0 is fine, nothing is read
+    for (size_t i = 0; i < size; i++) { //plain FNV-1a, it only has to notice a torn or scribbled record
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t JournalCheck(JournalRecord head, const char *first, const char *second) {
+    head.check = 0;
+    uint32_t hash = JournalHash(2166136261u, &head, sizeof(head));
+    hash = JournalHash(hash, first, head.firstLength);
+    return JournalHash(hash, second, head.secondLength);
+}
+
+static int JournalWriteAll(int fd, const char *data, size_t size) {
+    while (size > 0) { //write() may take less than everything
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        data += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+// bytes [from, to) of `in` appended to `out`
+static int CopyJournalTail(Session *session, int in, int out, uint64_t from, uint64_t to) {
+    size_t size = JOURNAL_GROUP_BYTES;
+    char *buffer = (char *)malloc(size);
+    if (buffer == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    int copied = 1;
+    while (copied && from < to) {
+        size_t chunk = to - from < size ? (size_t)(to - from) : size;
+        ssize_t n = pread(in, buffer, chunk, (off_t)from);
+        if (n < 0 && errno == EINTR)
+            continue;
+        copied = n > 0 && JournalWriteAll(out, buffer, (size_t)n);
+        from += n > 0 ? (uint64_t)n : 0;
+    }
+    free(buffer);
+    return copied;
+}
+
+// a new journal file: the header, then bytes [tailFrom, tailTo) of tailFd (the records
+// that came after the snapshot), put in place by rename; the descriptor to append to, -1 on failure
+static int ResetJournalFile(Session *session, const char *path, uint64_t firstSequence, int tailFd,
+                            uint64_t tailFrom, uint64_t tailTo) {
+    char *tmpPath = SuffixedPath(session, path, ".tmp");
+    JournalHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.firstSequence = firstSequence;
+    int fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0644); //read too: the next restart copies its tail
+    if (fd >= 0 && (!JournalWriteAll(fd, (const char *)&header, sizeof(header))
+                    || !CopyJournalTail(session, tailFd, fd, tailFrom, tailTo) || fsync(fd) != 0
+                    || rename(tmpPath, path) != 0)) {
+        close(fd);
+        unlink(tmpPath);
+        fd = -1;
+    }
+    free(tmpPath);
+    return fd; //the offset is already past what's in there
+}
+
+uint64_t JournalNextSequence(Journal *journal) {
+    if (journal == NULL)
+        return 0;
+    pthread_mutex_lock(&journal->lock);
+    uint64_t sequence = journal->nextSequence;
+    pthread_mutex_unlock(&journal->lock);
+    return sequence;
+}
+
+void JournalLog(Session *session, JournalOp op, int id, const char *name, const char *second) {
+    Journal *journal = session->registry->journal;
+    if (journal == NULL)
+        return;
+    JournalRecord head;
+    head.op = (uint8_t)op;
+    head.id = (uint8_t)id;
+    head.reserved = 0;
+    head.firstLength = name != NULL ? (uint32_t)strlen(name) + 1 : 0;
+    head.secondLength = second != NULL ? (uint32_t)strlen(second) + 1 : 0;
+    head.check = JournalCheck(head, name, second); //outside the lock, workers hash in parallel
+    size_t size = sizeof(head) + head.firstLength + head.secondLength;
+    pthread_mutex_lock(&journal->lock);
+    if (journal->failed) {
+        pthread_mutex_unlock(&journal->lock);
+        return;
+    }
+    if (journal->pendingLength + size > journal->pendingCapacity) {
+        size_t capacity = journal->pendingCapacity * 2;
+        while (journal->pendingLength + size > capacity)
+            capacity *= 2;
+        char *bigger = (char *)realloc(journal->pending, capacity);
+        if (bigger == NULL) {
+            OutStr(session, "Memory allocation failed.\n");
+            exit(1);
+        }
+        journal->pending = bigger;
+        journal->pendingCapacity = capacity;
+    }
+    char *at = journal->pending + journal->pendingLength;
+    memcpy(at, &head, sizeof(head));
+    if (name != NULL)
+        memcpy(at + sizeof(head), name, head.firstLength);
+    if (second != NULL)
+        memcpy(at + sizeof(head) + head.firstLength, second, head.secondLength);
+    journal->pendingLength += size;
+    journal->records++;
+    session->journalSequence = ++journal->nextSequence; //this record's number + 1
+    pthread_mutex_unlock(&journal->lock);
+}
+
+void JournalCommit(Journal *journal, uint64_t upto) {
+    pthread_mutex_lock(&journal->lock);
+    while (journal->durableSequence < upto && !journal->failed) {
+        if (journal->flushing) { //the batch on its way may already hold ours, check again when it lands
+            pthread_cond_wait(&journal->committed, &journal->lock);
+            continue;
+        }
+        //our turn: take everything pending (other sessions' records too), loggers go on in the other buffer
+        char *batch = journal->pending;
+        size_t length = journal->pendingLength;
+        size_t capacity = journal->pendingCapacity;
+        uint64_t end = journal->nextSequence;
+        journal->pending = journal->spare;
+        journal->pendingCapacity = journal->spareCapacity;
+        journal->pendingLength = 0;
+        journal->spare = batch;
+        journal->spareCapacity = capacity;
+        journal->flushing = 1;
+        pthread_mutex_unlock(&journal->lock);
+        int written = JournalWriteAll(journal->fd, batch, length) && fdatasync(journal->fd) == 0;
+        int error = errno;
+        pthread_mutex_lock(&journal->lock);
+        journal->flushing = 0;
+        if (written) {
+            journal->durableSequence = end;
+            journal->fileBytes += length;
+            journal->commits++;
+        }
+        else {
+            fprintf(stderr, "%s: %s, changes are no longer journaled\n", journal->path, strerror(error));
+            journal->failed = 1;
+        }
+        pthread_cond_broadcast(&journal->committed);
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+void JournalSync(Session *session) {
+    Journal *journal = session->registry->journal;
+    if (!session->output.interactive) { //a script: no one is waiting on it, so batch
+        pthread_mutex_lock(&journal->lock);
+        size_t pending = journal->pendingLength;
+        pthread_mutex_unlock(&journal->lock);
+        if (pending < JOURNAL_GROUP_BYTES)
+            return;
+    }
+    JournalCommit(journal, session->journalSequence);
+}
+
+int JournalWantsCompaction(Journal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    int wants = !journal->failed && journal->fileBytes + journal->pendingLength >= journal->compactBytes;
+    pthread_mutex_unlock(&journal->lock);
+    return wants;
+}
+
+// after a snapshot holding everything below `sequence` (= the first `offset` bytes): the journal
+// restarts with just the records past it. Commits wait meanwhile, changes keep being logged.
+static int RestartJournal(Session *session, uint64_t sequence, uint64_t offset) {
+    Journal *journal = session->registry->journal;
+    pthread_mutex_lock(&journal->lock);
+    while (journal->flushing)
+        pthread_cond_wait(&journal->committed, &journal->lock);
+    journal->flushing = 1; //the file stays put while its tail is copied
+    uint64_t end = journal->fileBytes;
+    pthread_mutex_unlock(&journal->lock);
+
+    int fd = ResetJournalFile(session, journal->path, sequence, journal->fd, offset, end);
+
+    pthread_mutex_lock(&journal->lock);
+    if (fd >= 0) {
+        close(journal->fd);
+        journal->fd = fd;
+        journal->fileBytes = sizeof(JournalHeader) + (end - offset);
+        journal->compactBytes = JOURNAL_COMPACT_BYTES;
+    }
+    else { //keep appending to the old file (the snapshot is only a head start), try again once it has grown as much again
+        fprintf(stderr, "%s: could not compact into %s\n", journal->path, journal->snapshotPath);
+        journal->compactBytes = journal->fileBytes + JOURNAL_COMPACT_BYTES;
+    }
+    journal->flushing = 0;
+    pthread_cond_broadcast(&journal->committed);
+    pthread_mutex_unlock(&journal->lock);
+    return fd >= 0;
+}
+
+int CompactJournal(Session *session, int background) {
+    Journal *journal = session->registry->journal;
+    if (CheckpointRunning(session->registry)) {
+        if (background) //one at a time, this one comes after it
+            return 0;
+        FinishCheckpoint(session, 1);
+    }
+    JournalCommit(journal, JournalNextSequence(journal)); //if the snapshot fails, the journal alone is still complete
+    pthread_mutex_lock(&journal->lock);
+    while (journal->flushing)
+        pthread_cond_wait(&journal->committed, &journal->lock);
+    if (journal->failed) {
+        pthread_mutex_unlock(&journal->lock);
+        return 0;
+    }
+    uint64_t sequence = journal->nextSequence;
+    uint64_t offset = journal->fileBytes; //all committed: the records below sequence are exactly the file
+    journal->compactBytes = UINT64_MAX; //not again while this one is under way
+    pthread_mutex_unlock(&journal->lock);
+
+    //snapshot first: a crash before the journal restarts only leaves records the snapshot already has
+    if (background && StartCheckpoint(session, journal->snapshotPath, 1, sequence, offset))
+        return 1; //FinishCheckpoint restarts the journal
+    if (WriteSnapshot(session, journal->snapshotPath, sequence))
+        return RestartJournal(session, sequence, offset);
+    fprintf(stderr, "%s: could not compact into %s\n", journal->path, journal->snapshotPath);
+    pthread_mutex_lock(&journal->lock);
+    journal->compactBytes = journal->fileBytes + JOURNAL_COMPACT_BYTES;
+    pthread_mutex_unlock(&journal->lock);
+    return 0;
+}
+
+int ApplyJournalRecord(Session *session, JournalOp op, int id, const char *name, const char *second) {
+    if (op == JOURNAL_SORT) {
+        SortOwners(session); //its message goes nowhere, the replay session has no output
+        return 1;
+    }
+    if (name == NULL)
+        return 0;
+    OwnerNode *owner = FindOwnerByName(session, name);
+    switch (op) {
+    case JOURNAL_NEW:
+        if (owner != NULL || id < 1 || id > POKEDEX_SIZE)
+            return 0;
+        owner = CreateOwnerNode(session, name);
+        PokedexInsert(session, owner, id);
+        AddOwner(session, owner);
+        return 1;
+    case JOURNAL_ADD:
+        if (owner == NULL || id < 1 || id > POKEDEX_SIZE || OwnerHasPokemon(owner, id))
+            return 0;
+        PokedexInsert(session, owner, id);
+        return 1;
+    case JOURNAL_RELEASE:
+        if (owner == NULL || !OwnerHasPokemon(owner, id))
+            return 0;
+        PokedexRemove(session, owner, id);
+        return 1;
+    case JOURNAL_EVOLVE: //same steps as EvolvePokemonId
+        if (owner == NULL || !OwnerHasPokemon(owner, id) || speciesTable.canEvolve[id - 1] == CANNOT_EVOLVE)
+            return 0;
+        PokedexRemove(session, owner, id);
+        if (!OwnerHasPokemon(owner, id + 1))
+            PokedexInsert(session, owner, id + 1);
+        return 1;
+    case JOURNAL_MERGE: {
+        OwnerNode *absorbed = second != NULL ? FindOwnerByName(session, second) : NULL;
+        if (owner == NULL || absorbed == NULL)
+            return 0;
+        MergeTrees(session, owner, absorbed);
+        FreeOwnerNode(session, absorbed);
+        return 1;
+    }
+    case JOURNAL_DELETE:
+        if (owner == NULL)
+            return 0;
+        FreeOwnerNode(session, owner);
+        return 1;
+    case JOURNAL_CLONE:
+        if (owner == NULL || second == NULL || FindOwnerByName(session, second) != NULL)
+            return 0;
+        CopyOwner(session, owner, second);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// replays data[sizeof(JournalHeader)..size) on top of the snapshot (records below `from` are in it already).
+// Sets *end to the bytes that hold whole records, *sequence to the number the next record gets.
+static const char *ReplayJournal(Session *session, const char *data, size_t size, uint64_t from,
+                                 size_t *end, uint64_t *sequence, long long *replayed) {
+    JournalHeader header;
+    memcpy(&header, data, sizeof(header));
+    Session replay; //same owners, nowhere to print
+    InitSession(&replay, session->registry, -1, -1);
+    replay.output.batch = 1;
+    size_t at = sizeof(header);
+    uint64_t next = header.firstSequence;
+    const char *problem = NULL;
+    while (size - at >= sizeof(JournalRecord)) {
+        JournalRecord head;
+        memcpy(&head, data + at, sizeof(head));
+        size_t room = size - at - sizeof(head);
+        if (head.firstLength > room || head.secondLength > room - head.firstLength)
+            break; //torn: the crash came mid-write
+        const char *first = data + at + sizeof(head);
+        const char *second = first + head.firstLength;
+        if (head.check != JournalCheck(head, first, second)
+            || (head.firstLength > 0 && first[head.firstLength - 1] != '\0')
+            || (head.secondLength > 0 && second[head.secondLength - 1] != '\0'))
+            break; //scribbled over, nothing after it can be trusted either
+        if (next >= from) {
+            if (!ApplyJournalRecord(&replay, (JournalOp)head.op, head.id, head.firstLength > 0 ? first : NULL,
+                                    head.secondLength > 0 ? second : NULL)) {
+                problem = "a record doesn't apply to the snapshot";
+                break;
+            }
+            (*replayed)++;
+        }
+        at += sizeof(head) + head.firstLength + head.secondLength;
+        next++;
+    }
+    free(replay.ownerNames);
+    *end = at;
+    *sequence = next;
+    return problem;
+}
+
+int OpenJournal(Session *session, const char *path) {
+    double started = NowSeconds();
+    char *snapshotPath = SuffixedPath(session, path, ".snap");
+    uint64_t from = 0; //first record the snapshot doesn't have
+    int fromSnapshot = access(snapshotPath, F_OK) == 0;
+    const char *problem = fromSnapshot ? ReadSnapshot(session, snapshotPath, &from) : NULL;
+    if (problem != NULL) {
+        fprintf(stderr, "%s: %s\n", snapshotPath, problem);
+        free(snapshotPath);
+        return 0;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        free(snapshotPath);
+        return 0;
+    }
+    size_t size = (size_t)info.st_size;
+    uint64_t sequence = from;
+    long long replayed = 0;
+    int reset = size < sizeof(JournalHeader); //new, or the crash came before its header got in
+    if (!reset) {
+        char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        JournalHeader header;
+        memset(&header, 0, sizeof(header));
+        if (data == MAP_FAILED)
+            problem = strerror(errno);
+        else {
+            memcpy(&header, data, sizeof(header));
+            if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0)
+                problem = "not a journal";
+            else if (header.byteOrder != SNAPSHOT_BYTE_ORDER)
+                problem = "written on a machine with the other byte order";
+            else if (header.version != JOURNAL_VERSION)
+                problem = "unsupported version";
+            else if (header.firstSequence > from)
+                problem = "records between the snapshot and the journal are missing";
+        }
+        size_t end = size;
+        if (problem == NULL)
+            problem = ReplayJournal(session, data, size, from, &end, &sequence, &replayed);
+        if (data != MAP_FAILED)
+            munmap(data, size);
+        if (problem == NULL && end < size) { //cut the torn tail off before anything is appended after it
+            fprintf(stderr, "%s: dropped %zu bytes of an incomplete record at the end\n", path, size - end);
+            if (ftruncate(fd, (off_t)end) != 0 || fdatasync(fd) != 0)
+                problem = strerror(errno);
+            size = end;
+        }
+        //no record past the snapshot: restart at it, so numbering goes on from the snapshot, not the old file
+        if (problem == NULL && sequence <= from && header.firstSequence != from)
+            reset = 1;
+        sequence = sequence > from ? sequence : from;
+    }
+    if (problem == NULL && reset) {
+        close(fd);
+        fd = ResetJournalFile(session, path, from, -1, 0, 0);
+        size = sizeof(JournalHeader);
+        if (fd < 0)
+            problem = "can't create it";
+    }
+    if (problem == NULL && lseek(fd, 0, SEEK_END) < 0)
+        problem = strerror(errno);
+    if (problem != NULL) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        if (fd >= 0)
+            close(fd);
+        free(snapshotPath);
+        return 0;
+    }
+
+    Journal *journal = (Journal *)calloc(1, sizeof(Journal));
+    if (journal == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    journal->path = SuffixedPath(session, path, "");
+    journal->snapshotPath = snapshotPath;
+    journal->fd = fd;
+    journal->nextSequence = sequence;
+    journal->durableSequence = sequence;
+    journal->fileBytes = size;
+    journal->compactBytes = JOURNAL_COMPACT_BYTES;
+    journal->pendingCapacity = journal->spareCapacity = JOURNAL_GROUP_BYTES;
+    journal->pending = (char *)malloc(journal->pendingCapacity);
+    journal->spare = (char *)malloc(journal->spareCapacity);
+    if (journal->pending == NULL || journal->spare == NULL) {
+        OutStr(session, "Memory allocation failed.\n");
+        exit(1);
+    }
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->committed, NULL);
+    session->registry->journal = journal; //from here on, changes are logged
+    if (fromSnapshot || replayed > 0) {
+        double seconds = NowSeconds() - started;
+        fprintf(stderr, "Recovered %d owners (%s + %lld journal records) in %.3f s, %.0f records/s.\n",
+                OwnerCount(session), fromSnapshot ? snapshotPath : "no snapshot", replayed, seconds,
+                seconds > 0 ? (double)replayed / seconds : 0.0);
+    }
+    return 1;
+}
+
+void CloseJournal(Session *session) {
+    Journal *journal = session->registry->journal;
+    JournalCommit(journal, JournalNextSequence(journal));
+    if (serveSocket != NULL) //how well group commit did
+        fprintf(stderr, "Journal: %lld records in %lld commits.\n", journal->records, journal->commits);
+    close(journal->fd);
+    pthread_mutex_destroy(&journal->lock);
+    pthread_cond_destroy(&journal->committed);
+    free(journal->pending);
+    free(journal->spare);
+    free(journal->path);
+    free(journal->snapshotPath);
+    free(journal);
+    session->registry->journal = NULL;
+}
+
+// --------------------------------------------------------------
+// 12i) Checkpoints
+// --------------------------------------------------------------
+
+static void AddLatency(LatencyStats *stats, double seconds) {
+    stats->count++;
+    stats->total += seconds;
+    if (seconds > stats->max)
+        stats->max = seconds;
+}
+
+int CheckpointRunning(OwnerRegistry *registry) {
+    Checkpoint *checkpoint = &registry->checkpoint;
+    pthread_mutex_lock(&checkpoint->lock);
+    int running = checkpoint->pid != 0;
+    pthread_mutex_unlock(&checkpoint->lock);
+    return running;
+}
+
+void NoteCommandLatency(OwnerRegistry *registry, double seconds) {
+    Checkpoint *checkpoint = &registry->checkpoint;
+    pthread_mutex_lock(&checkpoint->lock);
+    AddLatency(checkpoint->pid != 0 ? &checkpoint->during : &checkpoint->outside, seconds);
+    pthread_mutex_unlock(&checkpoint->lock);
+}
+
+int StartCheckpoint(Session *session, const char *path, int forJournal, uint64_t sequence, uint64_t journalOffset) {
+    Checkpoint *checkpoint = &session->registry->checkpoint;
+    char *copy = SuffixedPath(session, path, ""); //path may be a view into the input, the child needs it too
+    pthread_mutex_lock(&checkpoint->lock);
+    if (checkpoint->pid != 0) {
+        pthread_mutex_unlock(&checkpoint->lock);
+        free(copy);
+        return 0;
+    }
+    int owners = OwnerCount(session);
+    double started = NowSeconds();
+    pid_t pid = fork();
+    if (pid == 0) { //the child: every owner frozen as of the fork, whatever the parent does next
+        session->output.length = 0; //what's buffered is the parent's to print
+        session->output.fd = -1;
+        setpriority(PRIO_PROCESS, 0, CHECKPOINT_NICE); //if not allowed, commands just share the CPU evenly
+        _exit(WriteSnapshot(session, copy, sequence) ? 0 : 1); //_exit: no atexit flush of the parent's output
+    }
+    if (pid < 0) {
+        pthread_mutex_unlock(&checkpoint->lock);
+        free(copy);
+        return 0;
+    }
+    checkpoint->pid = pid;
+    checkpoint->path = copy;
+    checkpoint->forJournal = forJournal;
+    checkpoint->sequence = sequence;
+    checkpoint->journalOffset = journalOffset;
+    checkpoint->owners = owners;
+    checkpoint->started = started;
+    checkpoint->forkSeconds = NowSeconds() - started;
+    memset(&checkpoint->during, 0, sizeof(checkpoint->during));
+    pthread_mutex_unlock(&checkpoint->lock);
+    return 1;
+}
+
+int FinishCheckpoint(Session *session, int wait) {
+    Checkpoint *checkpoint = &session->registry->checkpoint;
+    if (wait)
+        pthread_mutex_lock(&checkpoint->lock);
+    else if (pthread_mutex_trylock(&checkpoint->lock) != 0) //another worker is looking already
+        return 0;
+    if (checkpoint->pid == 0) {
+        pthread_mutex_unlock(&checkpoint->lock);
+        return 0;
+    }
+    int status = 0;
+    pid_t done;
+    while ((done = waitpid(checkpoint->pid, &status, wait ? 0 : WNOHANG)) < 0 && errno == EINTR)
+        ;
+    if (done == 0) { //still writing
+        pthread_mutex_unlock(&checkpoint->lock);
+        return 0;
+    }
+    double seconds = NowSeconds() - checkpoint->started;
+    int written = done == checkpoint->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    Journal *journal = session->registry->journal;
+    if (checkpoint->forJournal && written) {
+        written = RestartJournal(session, checkpoint->sequence, checkpoint->journalOffset);
+    }
+    else if (checkpoint->forJournal) { //the old journal is still complete, try again once it has grown as much again
+        pthread_mutex_lock(&journal->lock);
+        journal->compactBytes = journal->fileBytes + JOURNAL_COMPACT_BYTES;
+        pthread_mutex_unlock(&journal->lock);
+    }
+    //on stderr: when it lands depends on timing, the output of a script must not
+    if (written)
+        fprintf(stderr, "Checkpoint: %d owners to %s in %.3f s (fork %.1f ms).", checkpoint->owners,
+                checkpoint->path, seconds, checkpoint->forkSeconds * 1e3);
+    else
+        fprintf(stderr, "Checkpoint to %s failed.", checkpoint->path);
+    const LatencyStats *during = &checkpoint->during, *outside = &checkpoint->outside;
+    if (during->count > 0)
+        fprintf(stderr, " %lld commands meanwhile: avg %.1f us, max %.1f us", during->count,
+                during->total / (double)during->count * 1e6, during->max * 1e6);
+    if (during->count > 0 && outside->count > 0)
+        fprintf(stderr, " (otherwise avg %.1f us, max %.1f us)", outside->total / (double)outside->count * 1e6,
+                outside->max * 1e6);
+    fputc('\n', stderr);
+    free(checkpoint->path);
+    checkpoint->path = NULL;
+    checkpoint->pid = 0;
+    pthread_mutex_unlock(&checkpoint->lock);
+    return written;
+}
+
+int CheckpointCommand(Session *session, const char *path) {
+    if (!StartCheckpoint(session, path, 0, JournalNextSequence(session->registry->journal), 0)) {
+        if (CheckpointRunning(session->registry))
+            OutStr(session, "A checkpoint is already being written.\n");
+        else
+            OutPrintf(session, "Could not start a checkpoint to %s.\n", path);
+        return 0;
+    }
+    OutPrintf(session, "Checkpoint of %d owners to %s started.\n", OwnerCount(session), path);
+    return 1;
+}
+
+void CheckpointMenu(Session *session) {
+    OutPrompt(session, "Snapshot file: ");
+    char *path = getDynamicInput(session);
+    FinishCheckpoint(session, 1); //one at a time: a script gets the same answers however fast the last one was
+    CheckpointCommand(session, path);
+}
+
+// --------------------------------------------------------------
+// 12j) Shared Pokedexes
+// --------------------------------------------------------------
+
+PokemonNode *SharedNode(Session *session, const PokemonData *data, PokemonNode *left, PokemonNode *right) {
+    PokemonNode *node = CreatePokemonNode(session, &session->registry->memoryPools.sharedNodes, data);
+    node->left = left; //the caller's references to the children are node's now
+    node->right = right;
+    UpdateHeight(node);
+    return node;
+}
+
+void RetainTree(PokemonNode *root) {
+    if (root != NULL)
+        root->refs++;
+}
+
+void ReleaseTree(Session *session, PokemonNode *root) {
+    while (root != NULL && --root->refs == 0) { //still pointed at from somewhere else => everything below stays
+        PokemonNode *right = root->right;
+        ReleaseTree(session, root->left);
+        ArenaFreeNode(&session->registry->memoryPools.sharedNodes, root);
+        root = right; //loop on the right side instead of recursing
+    }
+}
+
+const PokemonData *UnpackNode(Session *session, PokemonNode *node, PokemonNode **left, PokemonNode **right) {
+    const PokemonData *data = node->data;
+    *left = node->left;
+    *right = node->right;
+    if (node->refs == 1) { //only ours: its references to the children pass to us, the node gets recycled
+        ArenaFreeNode(&session->registry->memoryPools.sharedNodes, node);
+    }
+    else { //somebody else keeps it as it is, we need our own references
+        RetainTree(*left);
+        RetainTree(*right);
+        node->refs--;
+    }
+    return data;
+}
+
+PokemonNode *SharedBalance(Session *session, const PokemonData *data, PokemonNode *left, PokemonNode *right) {
+    if (NodeHeight(left) > NodeHeight(right) + 1) { //left heavy, same cases as RebalanceNode
+        PokemonNode *leftLeft, *leftRight;
+        const PokemonData *leftData = UnpackNode(session, left, &leftLeft, &leftRight);
+        if (NodeHeight(leftLeft) >= NodeHeight(leftRight)) //single rotation to the right
+            return SharedNode(session, leftData, leftLeft, SharedNode(session, data, leftRight, right));
+        PokemonNode *pivotLeft, *pivotRight; //left-right case: leftRight goes all the way up
+        const PokemonData *pivotData = UnpackNode(session, leftRight, &pivotLeft, &pivotRight);
+        PokemonNode *newLeft = SharedNode(session, leftData, leftLeft, pivotLeft);
+        return SharedNode(session, pivotData, newLeft, SharedNode(session, data, pivotRight, right));
+    }
+    if (NodeHeight(right) > NodeHeight(left) + 1) { //right heavy
+        PokemonNode *rightLeft, *rightRight;
+        const PokemonData *rightData = UnpackNode(session, right, &rightLeft, &rightRight);
+        if (NodeHeight(rightRight) >= NodeHeight(rightLeft)) //single rotation to the left
+            return SharedNode(session, rightData, SharedNode(session, data, left, rightLeft), rightRight);
+        PokemonNode *pivotLeft, *pivotRight; //right-left case
+        const PokemonData *pivotData = UnpackNode(session, rightLeft, &pivotLeft, &pivotRight);
+        PokemonNode *newLeft = SharedNode(session, data, left, pivotLeft);
+        return SharedNode(session, pivotData, newLeft, SharedNode(session, rightData, pivotRight, rightRight));
+    }
+    return SharedNode(session, data, left, right);
+}
+
+PokemonNode *SharedInsert(Session *session, PokemonNode *root, int id) {
+    if (root == NULL)
+        return SharedNode(session, &pokedex[id - 1], NULL, NULL);
+    if (root->data->id == id)
+        return root; //already there, our reference just comes back
+    PokemonNode *left, *right;
+    const PokemonData *data = UnpackNode(session, root, &left, &right);
+    if (id < data->id)
+        left = SharedInsert(session, left, id);
+    else
+        right = SharedInsert(session, right, id);
+    return SharedBalance(session, data, left, right);
+}
+
+PokemonNode *SharedRemove(Session *session, PokemonNode *root, int id) {
+    if (root == NULL)
+        return NULL;
+    PokemonNode *left, *right;
+    const PokemonData *data = UnpackNode(session, root, &left, &right);
+    if (id < data->id) {
+        left = SharedRemove(session, left, id);
+    }
+    else if (id > data->id) {
+        right = SharedRemove(session, right, id);
+    }
+    else if (left == NULL) { //one child or none: it takes the place, like ReleasePokemon
+        return right;
+    }
+    else if (right == NULL) {
+        return left;
+    }
+    else { //both present: the biggest one on the left moves up
+        const PokemonNode *max = left;
+        while (max->right != NULL)
+            max = max->right;
+        data = max->data;
+        left = SharedRemove(session, left, data->id);
+    }
+    return SharedBalance(session, data, left, right);
+}
+
+void ShareOwner(Session *session, OwnerNode *owner) {
+    if (owner->shared)
+        return;
+    MemoryPools *pools = &session->registry->memoryPools;
+    pthread_mutex_lock(&pools->sharedLock);
+    SpliceArena(&pools->sharedNodes, &owner->arena); //every node already counts its one parent, nothing to walk
+    owner->shared = 1;
+    pthread_mutex_unlock(&pools->sharedLock);
+}
+
+OwnerNode *CopyOwner(Session *session, OwnerNode *source, const char *name) {
+    OwnerNode *clone = CreateOwnerNode(session, name);
+    memcpy(clone->owned, source->owned, sizeof(clone->owned));
+    if (pokedexLayout == LAYOUT_COMPACT) {
+        CompactPokedex *dex = &clone->compact; //a couple of KB at most, copying beats sharing
+        CompactReserve(dex, source->compact.count);
+        if (source->compact.count > 0) //same array, same shape
+            memcpy(dex->nodes, source->compact.nodes, sizeof(CompactNode) * (size_t)source->compact.count);
+        dex->count = source->compact.count;
+        dex->root = source->compact.root;
+    }
+    else {
+        ShareOwner(session, source);
+        pthread_mutex_lock(&session->registry->memoryPools.sharedLock);
+        clone->shared = 1;
+        clone->pokedexRoot = source->pokedexRoot;
+        RetainTree(clone->pokedexRoot); //one more owner points at the root, that's the whole copy
+        pthread_mutex_unlock(&session->registry->memoryPools.sharedLock);
+    }
+    AddOwner(session, clone);
+    return clone;
+}
+
+OwnerNode *CloneOwner(Session *session, OwnerNode *source, const char *name) {
+    if (FindOwnerByName(session, name) != NULL) {
+        OutPrintf(session, "Owner '%s' already exists. Not creating a new Pokedex.\n", name);
+        return NULL;
+    }
+    OwnerNode *clone = CopyOwner(session, source, name);
+    JournalLog(session, JOURNAL_CLONE, 0, source->ownerName, name);
+    OutPrintf(session, "Cloned %s's Pokedex (%d Pokemon) into %s.\n", source->ownerName,
+              OwnerPokemonCount(clone), clone->ownerName);
+    return clone;
+}
+
+void MergeShared(Session *session, OwnerNode *first, OwnerNode *second) {
+    MemoryPools *pools = &session->registry->memoryPools;
+    ShareOwner(session, first); //its fresh nodes go where a shared second's are
+    for (int w = 0; w < POKEDEX_WORDS; w++) {
+        first->owned[w] |= second->owned[w];
+        second->owned[w] = 0;
+    }
+    uint8_t species[POKEDEX_SIZE];
+    PokemonNode *merged[POKEDEX_SIZE];
+    int size = BitmapSpecies(first->owned, species); //ascending, like the flattened merge
+    pthread_mutex_lock(&pools->sharedLock);
+    ReleaseTree(session, first->pokedexRoot); //the nodes only first had are reused right below
+    if (second->shared)
+        ReleaseTree(session, second->pokedexRoot);
+    for (int i = 0; i < size; i++)
+        merged[i] = CreatePokemonNode(session, &pools->sharedNodes, &pokedex[species[i]]);
+    first->pokedexRoot = BuildBalanced(merged, 0, size - 1);
+    pthread_mutex_unlock(&pools->sharedLock);
+    second->pokedexRoot = NULL; //an unshared second's nodes go with its arena
+}
+
+void PreviewMerge(Session *session, OwnerNode *first, OwnerNode *second) {
+    unsigned long long merged[POKEDEX_WORDS];
+    int total = 0, added = 0;
+    for (int w = 0; w < POKEDEX_WORDS; w++) {
+        merged[w] = first->owned[w] | second->owned[w];
+        total += CountBits(merged[w]);
+        added += CountBits(merged[w] & ~first->owned[w]);
+    }
+    if (total == 0) {
+        OutStr(session, "Both Pokedexes empty. Nothing to merge.\n");
+        return;
+    }
+    OutPrintf(session, "Merging %s and %s would give %s %d Pokemon (%d new):\n",
+              first->ownerName, second->ownerName, first->ownerName, total, added);
+    if (pokedexLayout == LAYOUT_COMPACT) { //no nodes to share, the bitmap already is the merged Pokedex
+        DisplayOwned(session, merged, ORDER_IN);
+    }
+    else {
+        MemoryPools *pools = &session->registry->memoryPools;
+        pthread_mutex_lock(&pools->sharedLock);
+        PokemonNode *preview = first->pokedexRoot;
+        RetainTree(preview); //first's tree as it is right now
+        for (int id = 1; id <= POKEDEX_SIZE; id++) {
+            if (OwnerHasPokemon(second, id) && !OwnerHasPokemon(first, id))
+                preview = SharedInsert(session, preview, id); //new path down to the new leaf, first's nodes untouched
+        }
+        pthread_mutex_unlock(&pools->sharedLock);
+        InOrderTraversal(session, preview);
+        pthread_mutex_lock(&pools->sharedLock);
+        ReleaseTree(session, preview); //the copied paths go, first's nodes get their count back
+        pthread_mutex_unlock(&pools->sharedLock);
+    }
+    OutStr(session, "Nothing was merged.\n");
+}
+
+void CloneOwnerMenu(Session *session) {
+    OutPrompt(session, "Owner to clone: ");
+    OwnerNode *source = FindOwnerByName(session, getDynamicInput(session)); //looked up before the next read
+    OutPrompt(session, "New owner's name: ");
+    char *name = getDynamicInput(session);
+    if (source == NULL) {
+        OutStr(session, "Owner not found.\n");
+        return;
+    }
+    CloneOwner(session, source, name);
+}
+
+void PreviewMergeMenu(Session *session) {
+    OutPrompt(session, "\n=== Merge Preview ===\n");
+    OutPrompt(session, "Enter name of first owner: ");
+    OwnerNode *first = FindOwnerByName(session, getDynamicInput(session));
+    OutPrompt(session, "Enter name of second owner: ");
+    OwnerNode *second = FindOwnerByName(session, getDynamicInput(session));
+    if (first == NULL || second == NULL) {
+        OutStr(session, "Owner not found.\n");
+        return;
+    }
+    PreviewMerge(session, first, second);
+}
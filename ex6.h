@@ -2,9 +2,14 @@
 #define EX6_H
 
 #include <ctype.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
 
 //i'm literally doing my own functions and the going here to look up if you have something like it then i don't find it and continuing and then after i finished everything i'm finding them :(
 typedef enum
@@ -48,429 +53,2069 @@ typedef struct PokemonNode
     PokemonData *data;
     struct PokemonNode *left;
     struct PokemonNode *right;
+    int height; // AVL height of this subtree (leaf == 1)
+    int refs;   // parents (or owners, for a root) pointing here; > 1 only in shared Pokedexes (12j)
 } PokemonNode;
 
+// Number of species in the static pokedex[] table (IDs are 1..POKEDEX_SIZE)
+#define POKEDEX_SIZE 151
+// 64-bit words needed for one bit per species
+#define POKEDEX_WORDS ((POKEDEX_SIZE + 63) / 64)
+
+// How many tree nodes one arena block holds (a whole Pokedex is at most 151)
+#define ARENA_BLOCK_NODES 32
+// How many owners one owner slab holds
+#define OWNER_BLOCK_SIZE 64
+
+// One slab of tree nodes, handed out by bumping `used`
+typedef struct PokemonBlock
+{
+    struct PokemonBlock *next;
+    int used;
+    PokemonNode nodes[ARENA_BLOCK_NODES];
+} PokemonBlock;
+
+// Per-owner node arena (all nodes of one Pokedex live here)
+typedef struct PokemonArena
+{
+    PokemonBlock *blocks;  // newest block first, bump allocation happens here
+    PokemonBlock *last;    // oldest block, so the whole chain can be spliced in O(1)
+    PokemonNode *freeList; // released nodes waiting for reuse, chained through ->left
+    PokemonNode *freeTail; // last node of freeList, so splicing two lists is O(1)
+} PokemonArena;
+
+// "No child" / "empty tree" in the compact layout
+#define COMPACT_NIL UINT32_MAX
+// First array size of a compact Pokedex (doubles up to POKEDEX_SIZE)
+#define COMPACT_MIN_CAPACITY 4
+
+typedef struct CompactNode //12 bytes instead of a 32-byte PokemonNode
+{
+    uint8_t species; // index into pokedex[] (id - 1)
+    uint8_t height;  // AVL height, a 151-node AVL tree is at most 10 high
+    uint32_t left;   // index into the owner's nodes[] or COMPACT_NIL
+    uint32_t right;
+} CompactNode;
+
+typedef struct CompactPokedex //one owner's tree in a single array, no holes
+{
+    CompactNode *nodes; // nodes[0..count) are all live, removal moves the last one into the gap
+    uint32_t root;      // COMPACT_NIL when empty
+    int count;
+    int capacity;
+} CompactPokedex;
+
+typedef enum
+{
+    LAYOUT_TREE,   // pointer AVL tree in a per-owner arena (default)
+    LAYOUT_COMPACT // CompactPokedex (--compact)
+} PokedexLayout;
+
 // Linked List Node (for Owners)
 typedef struct OwnerNode
 {
     char *ownerName;          // Owner's name
     PokemonNode *pokedexRoot; // Pointer to the root of the owner's Pokédex
+    PokemonArena arena;       // Where every node of pokedexRoot is allocated
+    CompactPokedex compact;   // used instead of pokedexRoot/arena under LAYOUT_COMPACT
+    unsigned long long owned[POKEDEX_WORDS]; // bit (id - 1) set <=> id is in pokedexRoot
     struct OwnerNode *next;   // Next owner in the linked list
     struct OwnerNode *prev;   // Previous owner in the linked list
+    int slot;                 // 1-based slot in ownerDirectory (-1 when not listed)
+    int shared;               // 1 = nodes live in memoryPools.sharedNodes and may be shared (12j)
 } OwnerNode;
 
-// Global head pointer for the linked list of owners
-OwnerNode *ownerHead = NULL;
-OwnerNode **ownerNames = NULL; //global pointer to array from struct because it told me that i have memory leaked if i did it directly from function
+// Starting number of slots in the owner name index (power of two)
+#define OWNER_INDEX_MIN_CAPACITY 64
+
+typedef struct OwnerSlot //one slot of the name index
+{
+    OwnerNode *owner;  // NULL = empty slot
+    unsigned int hash; // cached hash of owner->ownerName, saves most strcmp calls
+} OwnerSlot;
+
+typedef struct OwnerIndex //open addressing (linear probing) table: name -> owner
+{
+    OwnerSlot *slots;
+    int capacity; // always a power of two
+    int count;    // how many owners are indexed
+} OwnerIndex;
+
+typedef struct OwnerDirectory //the ring in list order, with holes where owners were deleted
+{
+    OwnerNode **slots; // slots[1..used], NULL = deleted owner (index 0 unused, Fenwick trees are 1-based)
+    int *tree;         // Fenwick tree over "slot is alive", k-th owner is a binary descent
+    int used;          // slots handed out so far (the last one is the ring's tail)
+    int count;         // live owners
+    int capacity;      // allocated slots (not counting index 0)
+} OwnerDirectory;
+
+// Block size for reading a script when it can't be mapped (pipes, terminals)
+#define INPUT_CHUNK_SIZE (64 * 1024)
+
+typedef struct InputReader //the whole script (mapped) or a sliding window of it (read)
+{
+    char *data;
+    size_t length;   // valid bytes in data
+    size_t position; // first byte not consumed yet
+    size_t capacity; // size of the read buffer (0 when mapped)
+    int mapped;      // data comes from mmap
+    int eof;         // read() has nothing more to give
+    int fd;          // where the script comes from (stdin, or a script file in the runner)
+} InputReader;
+
+// Bytes of output collected before they're written out in one go
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+typedef struct OutputBuffer //everything the program prints goes through here
+{
+    char data[OUTPUT_BUFFER_SIZE];
+    int length;      // bytes waiting in data
+    int interactive; // stdin is a terminal => flush before every read so prompts show up
+    int batch;       // headless script mode (-b): menus and prompts are not printed
+    int fd;          // where it goes (stdout, or the script's .out file in the runner)
+} OutputBuffer;
+
+typedef enum
+{
+    ORDER_BFS,
+    ORDER_PRE,
+    ORDER_IN,
+    ORDER_POST
+} TraversalOrder;
+
+typedef struct TreeCursor //one traversal in progress, no recursion and no malloc
+{
+    TraversalOrder order;
+    // stack (pre/in/post) or FIFO (BFS); every node goes in at most once and a
+    // Pokedex never has more than POKEDEX_SIZE nodes, so this can't overflow
+    PokemonNode *items[POKEDEX_SIZE];
+    int head;                 // BFS: next to dequeue
+    int top;                  // stack size, or BFS: next free slot
+    PokemonNode *current;     // in/post-order: subtree we still have to go down into
+    PokemonNode *lastVisited; // post-order: so we know the right side is done
+} TreeCursor;
+
+typedef struct OwnerBlock //slab of owners
+{
+    struct OwnerBlock *next;
+    int used;
+    OwnerNode owners[OWNER_BLOCK_SIZE];
+} OwnerBlock;
+
+typedef struct MemoryPools //everything recycled instead of going back to malloc
+{
+    PokemonBlock *spareBlocks;  // node blocks from deleted Pokedexes
+    OwnerBlock *ownerBlocks;    // every owner slab ever allocated
+    OwnerNode *freeOwners;      // deleted owners, chained through ->next
+    pthread_mutex_t spareLock;  // server: owners of different shards can grow at the same time
+    PokemonArena sharedNodes;   // nodes of shared Pokedexes (12j), freed one by one by refcount
+    pthread_mutex_t sharedLock; // guards sharedNodes and every refs count in it
+} MemoryPools;
+
+typedef struct LatencyStats //how long commands took
+{
+    long long count;
+    double total; // seconds
+    double max;
+} LatencyStats;
+
+typedef struct Checkpoint //a snapshot being written by a forked child (see 12i)
+{
+    pid_t pid;              // the child, 0 = no checkpoint running
+    int forJournal;         // journal compaction: the journal restarts at `sequence` once the snapshot is in
+    char *path;
+    uint64_t sequence;      // journal sequence the snapshot holds
+    uint64_t journalOffset; // journal bytes that hold the records below `sequence`
+    int owners;
+    double started;         // NowSeconds() at the fork
+    double forkSeconds;     // how long fork() itself held everything up
+    LatencyStats during;    // commands served while the child was writing
+    LatencyStats outside;   // every other command, for comparison
+    pthread_mutex_t lock;   // everything above (held while a finished checkpoint is wrapped up)
+} Checkpoint;
+
+// Checkpoint children run at this much lower priority, so commands get the CPU first
+#define CHECKPOINT_NICE 10
+
+typedef struct OwnerRegistry //every owner of one world (the server shares one between all clients)
+{
+    OwnerNode *ownerHead;          // head of the circular list of owners
+    OwnerIndex ownerIndex;         // every owner in the list, by name
+    OwnerDirectory ownerDirectory; // every owner in the list, by position
+    MemoryPools memoryPools;
+    struct Journal *journal;       // -J: every change gets logged here (NULL = not journaled)
+    Checkpoint checkpoint;         // background snapshot, if one is being written
+} OwnerRegistry;
+
+// First bytes of every snapshot file
+#define SNAPSHOT_MAGIC "PKDXSNAP"
+// Bumped whenever the layout below changes
+#define SNAPSHOT_VERSION 2
+// Written as a native uint32, reads back differently on a machine of the other endianness
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+typedef struct SnapshotHeader //start of a snapshot file, 48 bytes
+{
+    char magic[8];        // SNAPSHOT_MAGIC, no '\0'
+    uint32_t version;     // SNAPSHOT_VERSION
+    uint32_t byteOrder;   // SNAPSHOT_BYTE_ORDER
+    uint64_t journalSequence; // journal records already in this snapshot (recovery replays from here on)
+    uint64_t ownerCount;  // SnapshotOwner records right after this header
+    uint64_t namesOffset; // file offset of the names blob (right after the records)
+    uint64_t namesBytes;  // every name with its '\0', back to back
+} SnapshotHeader;
+
+typedef struct SnapshotOwner //one owner, 32 bytes, in list order starting at the head
+{
+    unsigned long long owned[POKEDEX_WORDS]; // same bits as OwnerNode.owned, the whole Pokedex
+    uint64_t nameOffset;                     // into the names blob
+} SnapshotOwner;
+
+typedef struct SnapshotWriter //buffered write() of a snapshot
+{
+    int fd;
+    int failed;    // a write() failed, the file is no good
+    size_t length; // bytes waiting in data
+    char data[OUTPUT_BUFFER_SIZE];
+} SnapshotWriter;
+
+// First bytes of a journal file
+#define JOURNAL_MAGIC "PKDXJRNL"
+// Bumped whenever the record layout changes
+#define JOURNAL_VERSION 1
+// Pending journal bytes a script session collects before committing them
+#define JOURNAL_GROUP_BYTES (64 * 1024)
+// Journal size that triggers a compaction into "<journal>.snap" (~1M records, keeps recovery short)
+#define JOURNAL_COMPACT_BYTES (32 * 1024 * 1024)
+
+typedef enum
+{
+    JOURNAL_NEW = 1, // name, starter ID
+    JOURNAL_ADD,     // name, ID
+    JOURNAL_RELEASE, // name, ID
+    JOURNAL_EVOLVE,  // name, ID that evolved
+    JOURNAL_MERGE,   // name (keeps everything), second name (removed)
+    JOURNAL_DELETE,  // name
+    JOURNAL_SORT,    // nothing
+    JOURNAL_CLONE    // name (source), second name (the clone)
+} JournalOp;
+
+typedef struct JournalHeader //start of a journal file, 24 bytes
+{
+    char magic[8];          // JOURNAL_MAGIC, no '\0'
+    uint32_t version;       // JOURNAL_VERSION
+    uint32_t byteOrder;     // SNAPSHOT_BYTE_ORDER
+    uint64_t firstSequence; // sequence number of the first record (records are numbered in file order)
+} JournalHeader;
+
+typedef struct JournalRecord //fixed 16-byte head of a record, the names follow it
+{
+    uint8_t op;            // JournalOp
+    uint8_t id;            // Pokemon or starter ID, 0 if none
+    uint16_t reserved;     // 0
+    uint32_t firstLength;  // bytes of the first name right after this head, '\0' included (0 = none)
+    uint32_t secondLength; // same for the second name (merge only)
+    uint32_t check;        // FNV-1a of the head (check = 0) and both names: replay stops at a torn or damaged record
+} JournalRecord;
+
+typedef struct Journal //-J: the world's change log (one per registry, the server's workers share it)
+{
+    char *path;               // the journal
+    char *snapshotPath;       // path + ".snap", what compaction writes
+    int fd;
+    uint64_t nextSequence;    // the next record's number
+    uint64_t durableSequence; // every record below this is written and fdatasync'ed
+    char *pending;            // records appended since the last commit took its batch
+    size_t pendingLength;
+    size_t pendingCapacity;
+    char *spare;              // the other buffer: pending and spare swap at every commit
+    size_t spareCapacity;
+    uint64_t fileBytes;       // journal size on disk
+    uint64_t compactBytes;    // compact once fileBytes gets here (pushed back after a compaction that failed)
+    int flushing;             // someone is writing a batch (or compacting): commit waits for them
+    int failed;               // a write failed: changes are no longer logged (said once on stderr)
+    long long records;        // appended since startup
+    long long commits;        // fdatasync calls since startup
+    pthread_mutex_t lock;     // everything above except path/snapshotPath
+    pthread_cond_t committed; // flushing went back to 0
+} Journal;
+
+typedef struct SnapshotView //a snapshot mapped read-only (-R): owners are reached by offset, nothing is built
+{
+    const char *data;            // the whole file, MAP_SHARED so every process reading it shares the page cache
+    size_t size;
+    const SnapshotOwner *owners; // owners[k] is the (k+1)-th owner in list order
+    const char *names;           // the names blob
+    uint64_t namesBytes;
+    int count;
+} SnapshotView;
+
+typedef struct Session //one script (or one server request): its input, its output and the owners it works on
+{
+    InputReader input;
+    OutputBuffer output;
+    OwnerRegistry *registry;
+    OwnerNode **ownerNames;      //pointer to array in the session because it told me that i have memory leaked if i did it directly from function
+    const SnapshotView *snapshot; // -R: read-only session served off a mapped snapshot (registry stays empty), NULL otherwise
+    uint64_t journalSequence;     // one past the last record this session logged (the server commits up to it)
+    int threads;                 // workers for the league and bulk merges (0 = one per online CPU)
+    jmp_buf endOfInput;          // EndOfInput() jumps back to RunSession() from any prompt
+} Session;
+
+typedef struct SessionRunner //thread pool replaying one script per session
+{
+    char **scripts;  // script paths, output goes to "<script>.out"
+    int count;
+    int next;        // next script nobody has taken yet
+    int failed;      // scripts that couldn't be opened
+    pthread_mutex_t lock;
+} SessionRunner;
+
+typedef struct SpeciesTable //pokedex[] column by column, so batch loops read contiguous arrays
+{
+    int id[POKEDEX_SIZE];
+    int hp[POKEDEX_SIZE];
+    int attack[POKEDEX_SIZE];
+    unsigned char type[POKEDEX_SIZE];      // PokemonType
+    unsigned char canEvolve[POKEDEX_SIZE]; // EvolutionStatus
+    double score[POKEDEX_SIZE];            // hp * 1.2 + attack * 1.5, the fight formula
+    int16_t scoreRank[POKEDEX_SIZE];       // species scoring lower than this one: same order and ties as score
+    uint8_t byScore[POKEDEX_SIZE];         // species indices, strongest first (lower ID first on equal score)
+} SpeciesTable;
+
+SpeciesTable speciesTable; // filled once by InitSpeciesTable(), read-only after that
+
+// Most games a league match can have (one per species)
+#define LEAGUE_MAX_GAMES POKEDEX_SIZE
+
+typedef struct LeagueWorker //one thread of the league pool
+{
+    pthread_mutex_t lock;    // guards next/end, thieves take them too
+    int next;                // rows [next, end) of the match triangle still queued here
+    int end;
+    int *wins;               // per lineup, weighted by how many owners field it
+    int *draws;              // (private to this worker, summed at the end in worker order
+    int *losses;             //  so the totals don't depend on who did which row)
+    int16_t *diff;           // scratch: game balance of the current row against every column
+    struct League *league;
+    pthread_t thread;
+} LeagueWorker;
+
+typedef struct League //every owner against every other owner, best of `games`
+{
+    int games;        // games per match: k-th strongest against k-th strongest
+    int lineups;      // distinct lineups (owners with the same top `games` play identically)
+    int16_t *top;     // top[g * lineups + l]: score rank of lineup l's g-th strongest, -1 = none (forfeit)
+    int *members;     // owners fielding each lineup
+    LeagueWorker *workers;
+    int threads;
+} League;
+
+typedef struct LineupKey //qsort has no context pointer in C99, so every key carries what the compare needs
+{
+    const int16_t *row; // the owner's lineup (`games` score ranks)
+    int games;
+    int owner;          // position in the owner list
+} LineupKey;
+
+typedef struct StandingKey //one row of the final table
+{
+    long long points;
+    long long wins;
+    int owner;
+} StandingKey;
+
+typedef struct BulkMerge //tree reduction: each level merges owners[i + stride] into owners[i]
+{
+    Session *session;   // whose memory pools the merges use
+    OwnerNode **owners; // owners[0] ends up with every Pokemon
+    int count;
+    int stride;         // distance between the two owners of a pair at this level
+    int nextPair;       // next pair of this level nobody has taken yet
+    pthread_mutex_t lock;
+} BulkMerge;
+
+// Per-owner lock shards in the server (an owner's shard is its directory slot mod this)
+#define SERVER_SHARDS 64
+// Most worker threads the server starts
+#define SERVER_MAX_WORKERS 64
+// Most unanswered bytes the server keeps for one client (a line that never ends gets it dropped)
+#define SERVER_MAX_PENDING (1024 * 1024)
+// Requests each load generator client sends
+#define LOAD_REQUESTS 20000
+
+typedef struct ServerClient //one connection
+{
+    int fd;
+    char *pending;   // received but not answered yet: whole lines, maybe a partial one at the end
+    size_t length;
+    size_t capacity;
+    int busy;        // queued or with a worker: the event loop doesn't touch pending or read more
+    int hungUp;      // peer closed or sent "quit": dropped as soon as it's idle
+    struct ServerClient *nextQueued;
+} ServerClient;
+
+typedef struct Server //the event loop, its workers and the owners they all share
+{
+    OwnerRegistry registry;
+    pthread_rwlock_t registryLock;              // read: lookups and read-only commands; write: new/delete/merge/sort
+    pthread_rwlock_t shardLocks[SERVER_SHARDS]; // one owner's Pokedex: read for display/fight, write for add/release/evolve
+    int listenFd;
+    int wakeFds[2];          // pipe: a worker handed a client back, rebuild the poll set
+    ServerClient **clients;  // every open connection (only the event loop touches this)
+    int clientCount;
+    int clientCapacity;
+    ServerClient *queueHead; // clients with a whole line waiting for a worker
+    ServerClient *queueTail;
+    pthread_mutex_t queueLock; // guards the queue, busy, hungUp and stopping
+    pthread_cond_t queueReady;
+    int stopping;            // "shutdown" was received
+    pthread_t *workers;
+    int threads;
+} Server;
+
+typedef struct LoadClient //one connection of the load generator
+{
+    int id;
+    int fd;
+    const char *path;  // the server's socket
+    int requests;      // how many to send
+    int done;          // how many got their answer
+    double *latencies; // seconds, one per answered request
+    pthread_t thread;
+    int started;
+    char reply[4096];  // answers are read through here, only the end marker matters
+} LoadClient;
+
+int workerThreads = 0; // -j: threads for the league and bulk merges (or for the sessions of the runner), 0 = one per online CPU
+int batchMode = 0;     // -b: every session runs headless
+const char *serveSocket = NULL; // -S PATH: run the server on this socket
+const char *loadSocket = NULL;  // -L PATH: run the load generator against this socket
+const char *snapshotFile = NULL; // -R FILE: answer read-only menus straight off this snapshot
+SnapshotView mappedSnapshot;     // snapshotFile once mapped, shared by every session
+const char *journalFile = NULL;  // -J FILE: recover from FILE.snap + FILE, log every change to FILE
+
+PokedexLayout pokedexLayout = LAYOUT_TREE; // picked once at startup, every owner uses it
+int memoryReport = 0;                      // -m: print Pokedex memory per owner at exit
+
+/* ------------------------------------------------------------
+   1) Safe Input + Utility
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Remove leading/trailing whitespace (including '\r').
+ * @param str modifiable string
+ * @return first non-blank char of str (nothing gets shifted, the end is cut with '\0')
+ * Why we made it: We must handle CR/LF or random spaces in user input.
+ */
+char *trimWhitespace(char *str);
+
+/**
+ * @brief C99-friendly strdup replacement.
+ * @param src source string
+ * @return newly allocated copy of src
+ * Why we made it: Some old systems lack strdup; we do it ourselves.
+ */
+char *myStrdup(const char *src);
+
+/**
+ * @brief Read an integer safely, re-prompt if invalid.
+ * @param prompt text to display
+ * @return valid integer from user
+ * Why we made it: We want robust menu/ID input handling.
+ */
+int readIntSafe(Session *session, const char *prompt);
+
+/**
+ * @brief Read a line of the session's input, trim whitespace, hand back a view into the input buffer.
+ * @return the trimmed line (NOT malloc'd: valid until the next read, copy it to keep it)
+ * Why we made it: We need flexible name input that handles CR/LF etc. Names
+ * only get copied once, when CreateOwnerNode stores them.
+ */
+char *getDynamicInput(Session *session);
+
+/**
+ * @brief Parse a whole line as a decimal int (leading blanks and a sign allowed).
+ * @param str the line, trailing '\r' already removed
+ * @param value where the number goes
+ * @return 1 if the whole line was a number, 0 otherwise
+ * Why we made it: strtol per menu choice was a big part of replay time.
+ */
+int ParseIntLine(const char *str, int *value);
+
+/* ------------------------------------------------------------
+   1a) Input Reader
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Map the session's script if it's a regular file, otherwise set up a block-read buffer.
+ * Why we made it: One getchar() per byte and an fgets+strtol per number were
+ * the input side of every replay; now the script is tokenized in place.
+ */
+void InitInput(Session *session);
+
+/**
+ * @brief Next line of input, '\n' replaced by '\0' in place.
+ * @return the line, or NULL at end of input. Valid until the next read.
+ */
+char *NextLine(Session *session);
+
+/**
+ * @brief Next raw byte of input (for the single-char direction prompt).
+ * @return the byte or EOF
+ */
+int NextChar(Session *session);
+
+/**
+ * @brief Unmap / free the input buffer.
+ */
+void CloseInput(Session *session);
+
+/**
+ * @brief Input ran out: jump back to RunSession(), which cleans up the session.
+ * Why we made it: A script without a final "7" used to spin forever on "Invalid input.".
+ * It used to exit() right here, which would take every other session down with it.
+ */
+void EndOfInput(Session *session);
+
+/**
+ * @brief Free every owner, pool, index and the input buffer, flush output.
+ */
+void ShutdownProgram(Session *session);
+
+/* ------------------------------------------------------------
+   1c) Sessions
+   ------------------------------------------------------------ */
+
+// Everything below that reads input, prints, or touches the owners takes the
+// Session it works on as first argument; nothing in here is shared between
+// sessions except the read-only tables and the command-line options.
+
+/**
+ * @brief Empty registry: no owners, empty pools.
+ * @param registry the registry to set up
+ */
+void InitRegistry(OwnerRegistry *registry);
+
+/**
+ * @brief Session reading from inputFd and writing to outputFd, working on registry's owners.
+ * @param session the session to set up
+ * @param registry the owners (usually the session's own, shared in the server)
+ * @param inputFd the script
+ * @param outputFd where its output goes
+ */
+void InitSession(Session *session, OwnerRegistry *registry, int inputFd, int outputFd);
+
+/**
+ * @brief Replay the whole script through the main menu, then shut the session down.
+ * @param session an initialized session
+ */
+void RunSession(Session *session);
+
+/**
+ * @brief Run one script file in its own session, output to "<path>.out".
+ * @param path the script
+ * @return 1 if it ran, 0 if a file couldn't be opened (reason on stderr)
+ */
+int ReplayScript(const char *path);
+
+/**
+ * @brief Runner worker: take scripts until there are none left.
+ * @param arg the SessionRunner
+ * @return NULL
+ */
+void *SessionWorker(void *arg);
+
+/**
+ * @brief Replay many independent scripts at once, one session per script.
+ * @param scripts script paths
+ * @param count how many
+ * @param threads pool size (<= 0 => one per online CPU)
+ * @return how many scripts couldn't be opened
+ * Why we made it: One process per customer session meant an exec, a fresh
+ * heap and a fresh species table every time; the pool reuses all of it.
+ * Sessions run their league and bulk merges on one thread, the pool already
+ * keeps every CPU busy.
+ */
+int RunSessions(char **scripts, int count, int threads);
+
+/* ------------------------------------------------------------
+   1b) Buffered Output
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Append text / one char / a decimal int to the output buffer.
+ * Why we made it: Six printf calls per Pokemon meant stdio locking and format
+ * parsing on every field; this is a memcpy and a hand-rolled itoa.
+ */
+void OutStr(Session *session, const char *str);
+void OutChar(Session *session, char c);
+void OutInt(Session *session, int value);
+
+/**
+ * @brief printf into the output buffer (for the rare messages with %.2f and friends).
+ * @param format printf format
+ */
+void OutPrintf(Session *session, const char *format, ...);
+
+/**
+ * @brief Print menu / prompt text, unless we're running headless.
+ * @param str the prompt
+ * Why we made it: In batch mode only operation results should come out, and
+ * menus were most of the bytes written when replaying a script.
+ */
+void OutPrompt(Session *session, const char *str);
+
+/**
+ * @brief Write whatever is buffered to the session's output with as few write() calls as possible.
+ */
+void OutFlush(Session *session);
+
+/**
+ * @brief Flush only if a human is typing (stdin is a terminal).
+ * Why we made it: Prompts must be visible before we block on input, but a
+ * replayed script shouldn't pay one write per command for it.
+ */
+void OutFlushBeforeInput(Session *session);
+
+/**
+ * @brief Return a string for a given PokemonType enum.
+ * @param type the enum
+ * @return string like "GRASS", "FIRE", etc.
+ * Why we made it: So we can print readable type names.
+ */
+const char *getTypeName(PokemonType type);
+
+/* ------------------------------------------------------------
+   2) Creating & Freeing Nodes
+   ------------------------------------------------------------ */
+/**
+ * @brief Owner with a copy of the name and an empty Pokedex, not listed anywhere yet.
+ * @param ownerName the name (copied)
+ * @return the new owner (from the owner slabs)
+ */
+OwnerNode *CreateOwnerNode(Session *session, const char *ownerName);
+/**
+ * @brief Create a BST node with a copy of the given PokemonData.
+ * @param arena the owner's arena the node is carved from
+ * @param data pointer to PokemonData (like from the global pokedex)
+ * @return newly allocated PokemonNode*
+ * Why we made it: We need a standard way to allocate BST nodes.
+ */
+PokemonNode *CreatePokemonNode(Session *session, PokemonArena *arena, const PokemonData *data);
+
+/**
+ * @brief Take a node from the arena: recycled one first, otherwise a pointer bump.
+ * @param arena the owner's arena
+ * @return uninitialized node memory
+ * Why we made it: One malloc per node dominated the profile of replay runs.
+ */
+PokemonNode *ArenaAllocNode(Session *session, PokemonArena *arena);
+
+/**
+ * @brief Give one node back to its arena's free list.
+ * @param arena the owner's arena
+ * @param node node that is no longer in the tree
+ */
+void ArenaFreeNode(PokemonArena *arena, PokemonNode *node);
+
+/**
+ * @brief Drop a whole arena: its block chain is spliced onto the spare list.
+ * @param arena the owner's arena (empty afterwards)
+ * Why we made it: Deleting a Pokedex becomes O(1), no tree walk needed.
+ */
+void ReleaseArena(Session *session, PokemonArena *arena);
+
+/**
+ * @brief Move every block (and free node) of `from` into `into`, leaving `from` empty.
+ * @param into arena that takes ownership
+ * @param from arena that gets emptied
+ * Why we made it: Merging reuses the second owner's nodes, so their memory
+ * has to follow them into the first owner's arena.
+ */
+void SpliceArena(PokemonArena *into, PokemonArena *from);
+
+/**
+ * @brief Owner slab allocation / recycling.
+ * Why we made it: Owners come and go a lot in merges and deletes.
+ */
+OwnerNode *AllocOwnerNode(Session *session);
+void RecycleOwnerNode(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Free a single owner's name + arena and return the node to the pool.
+ * @param owner owner already unlinked from the list
+ */
+void DestroyOwner(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Hand every pooled block back to the system at program exit.
+ * Why we made it: Pools keep memory around on purpose, this is where it ends.
+ */
+void FreeMemoryPools(Session *session);
+/**
+ * @brief Put a new owner at the end of the circular owners list (and in the index and directory).
+ * @param owner from CreateOwnerNode
+ * Why we made it: Each user is represented as an OwnerNode.
+ */
+void AddOwner(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Create, fill with the starter and list a new owner, no prompts.
+ * @param name owner name (copied)
+ * @param starterId species ID of the starter (see StarterId)
+ * @return the owner, or NULL (and a message) if the name is taken
+ * Why we made it: The server and the journal create owners without the menu.
+ */
+OwnerNode *NewOwner(Session *session, const char *name, int starterId);
+/**
+ * @brief Free one PokemonNode (including name).
+ * @param node pointer to node
+ * Why we made it: Avoid memory leaks for single nodes.
+ */
+PokemonNode* ReleasePokemon(PokemonArena *arena, PokemonNode *root, PokemonData *data); //releases a node from bst
+//void FreePokemonNode(PokemonNode *node);
+void FreeHead(Session *session); //frees head of the list
+
+/**
+ * @brief Free an OwnerNode (including name and entire Pokedex BST).
+ * @param owner pointer to the owner
+ * Why we made it: Deleting an owner also frees their Pokedex & name.
+ */
+void FreeOwnerNode(Session *session, OwnerNode *owner);
+
+/* ------------------------------------------------------------
+   3) BST Insert, Search, Remove
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Insert a PokemonNode into BST by ID; duplicates freed.
+ * @param arena arena new nodes come from
+ * @param root pointer to BST root
+ * @param newNode node to insert
+ * @return updated BST root
+ * Why we made it: Standard BST insertion ignoring duplicates, rebalanced on the way back up (AVL).
+ */
+PokemonNode *InsertPokemonNode(Session *session, PokemonArena *arena, PokemonNode *newNode, int pokemonId, int subChoice);
+
+/**
+ * @brief Height of a subtree, 0 for an empty one.
+ * @param node subtree root (may be NULL)
+ * @return stored AVL height
+ * Why we made it: So the balancing code never has to check NULL itself.
+ */
+int NodeHeight(PokemonNode *node);
+
+/**
+ * @brief Recompute node->height from its two children.
+ * @param node non-NULL node
+ */
+void UpdateHeight(PokemonNode *node);
+
+/**
+ * @brief Single left/right rotations around a node.
+ * @param node subtree root before the rotation
+ * @return new subtree root after the rotation
+ * Why we made it: The building blocks of AVL rebalancing.
+ */
+PokemonNode *RotateLeft(PokemonNode *node);
+PokemonNode *RotateRight(PokemonNode *node);
+
+/**
+ * @brief Restore the AVL property at one node after an insert/remove below it.
+ * @param node subtree root whose children changed
+ * @return new (balanced) subtree root
+ * Why we made it: Bulk loaders insert IDs in ascending order, which turned the
+ * plain BST into a linked list. Rebalancing keeps every operation O(log n).
+ */
+PokemonNode *RebalanceNode(PokemonNode *node);
+
+/**
+ * @brief Search for a Pokemon by ID in the BST (kept for old callers, it's
+ *        SearchPokemonBST now: the AVL tree never degenerates, so there's
+ *        nothing a level-by-level scan would find that the descent misses).
+ * @param root BST root
+ * @param id ID to find
+ * @return pointer to found node or NULL
+ */
+PokemonNode *SearchPokemonBFS(PokemonNode *root, int id);
+
+/**
+ * @brief Ordered search: walk down the BST by ID, no queue, no malloc.
+ * @param root BST root
+ * @param id ID to find
+ * @return pointer to found node or NULL
+ * Why we made it: The tree is sorted by ID (and balanced), so one O(log n)
+ * descent beats a full BFS scan over every node.
+ */
+PokemonNode *SearchPokemonBST(PokemonNode *root, int id);
+
+/**
+ * @brief Resolve an ID in an owner's Pokedex once and hand back the node.
+ * @param owner pointer to the Owner
+ * @param id ID to find (anything outside 1..151 just returns NULL)
+ * @return the node (a handle the caller keeps reusing) or NULL; always NULL in
+ *         the compact layout, which has no PokemonNodes (use the bitmap there)
+ * Why we made it: Menu operations used to search the same ID over and over.
+ */
+PokemonNode *ResolvePokemon(OwnerNode *owner, int id);
+
+/* ------------------------------------------------------------
+   3b) Owned-ID Bitmap
+   ------------------------------------------------------------ */
+
+/**
+ * @brief O(1) "does this owner have ID x" using the owner's bitmap.
+ * @param owner pointer to the Owner
+ * @param id ID to check (out of range => 0)
+ * @return 1 if owned, 0 otherwise
+ * Why we made it: IDs are bounded, so a bit per species answers membership
+ * for duplicate checks, fights and evolves without touching the tree.
+ */
+int OwnerHasPokemon(const OwnerNode *owner, int id);
+
+/**
+ * @brief Same test on a bare bitset (a snapshot record has no OwnerNode).
+ * @param owned POKEDEX_WORDS words
+ * @param id any int, out of range => 0
+ */
+int OwnedHas(const unsigned long long *owned, int id);
+
+/**
+ * @brief Set / clear the bit for one ID. Every tree insert/release goes with one of these.
+ * @param owner pointer to the Owner
+ * @param id ID in 1..151
+ */
+void MarkOwned(OwnerNode *owner, int id);
+void UnmarkOwned(OwnerNode *owner, int id);
+
+/**
+ * @brief Index of the lowest set bit of a non-zero word.
+ * @param word non-zero 64-bit word
+ * @return 0..63
+ */
+int LowestBit(unsigned long long word);
+
+/**
+ * @brief Number of set bits in a word.
+ * @param word 64-bit word
+ * @return 0..64
+ */
+int CountBits(unsigned long long word);
+
+/**
+ * @brief How many Pokemon the owner has (popcount of the bitmap).
+ * @param owner pointer to the Owner
+ * @return 0..151
+ */
+int OwnerPokemonCount(const OwnerNode *owner);
+
+/**
+ * @brief Data of the owner's lowest owned ID.
+ * @param owner owner with at least one Pokemon
+ * @return entry in pokedex[]
+ * Why we made it: Right after creation that's the starter, whatever the layout.
+ */
+const PokemonData *FirstOwned(const OwnerNode *owner);
+
+/* ------------------------------------------------------------
+   3c) Compact Pokedex
+   ------------------------------------------------------------ */
+
+// The same AVL tree as pokedexRoot, but the nodes sit in one array per owner:
+// a byte for the species and 32-bit indices for the children. A full 151-entry
+// Pokedex is 1812 bytes in one allocation, against 151 * 32 bytes of pointer
+// nodes spread over five arena blocks.
+
+/**
+ * @brief Empty compact Pokedex (no allocation until the first insert).
+ * @param dex the Pokedex
+ */
+void CompactInit(CompactPokedex *dex);
+
+/**
+ * @brief Free the node array, leaving an empty Pokedex.
+ * @param dex the Pokedex
+ */
+void CompactFree(CompactPokedex *dex);
+
+/**
+ * @brief Insert a species (already known not to be there), AVL-balanced.
+ * @param dex the Pokedex
+ * @param species pokedex[] index (id - 1)
+ */
+void CompactInsert(CompactPokedex *dex, int species);
+
+/**
+ * @brief Remove a species (already known to be there), AVL-balanced.
+ * @param dex the Pokedex
+ * @param species pokedex[] index (id - 1)
+ * Why we made it: The freed slot is filled with the last node so the array
+ * never has holes and never needs a free list.
+ */
+void CompactRemove(CompactPokedex *dex, int species);
+
+/**
+ * @brief Throw the tree away and rebuild it perfectly balanced from a bitmap.
+ * @param dex the Pokedex
+ * @param owned POKEDEX_WORDS words, bit (id - 1) set <=> id goes in
+ * Why we made it: Merging two compact Pokedexes is just an OR of the bitmaps,
+ * the bits already come out in ID order.
+ */
+void CompactRebuild(CompactPokedex *dex, const unsigned long long *owned);
+
+/**
+ * @brief Print the compact tree in BFS / pre / in / post order.
+ * @param dex the Pokedex
+ * @param order traversal order
+ */
+void CompactDisplay(Session *session, const CompactPokedex *dex, TraversalOrder order);
+
+/**
+ * @brief Alphabetical print: node array straight into rank slots, like DisplayAlphabetical.
+ * @param dex the Pokedex
+ */
+void CompactDisplayAlphabetical(Session *session, const CompactPokedex *dex);
+
+/**
+ * @brief Bytes the owner's Pokedex has allocated in the active layout.
+ * @param owner pointer to the Owner
+ * @return arena blocks (tree) or the node array (compact)
+ */
+size_t PokedexBytes(const OwnerNode *owner);
+
+/**
+ * @brief Print "name: N Pokemon, X bytes" for every owner plus totals to stderr.
+ * Why we made it: To compare the two layouts on a real script (-m).
+ */
+void PrintMemoryReport(Session *session);
+
+/**
+ * @brief Layout-independent Pokedex operations; bitmap kept in sync.
+ * @param owner pointer to the Owner
+ * @param id ID in 1..151 (insert: not owned yet, remove: owned)
+ * Why we made it: Menus don't care whether the tree is pointers or indices.
+ */
+void PokedexInsert(Session *session, OwnerNode *owner, int id);
+void PokedexRemove(Session *session, OwnerNode *owner, int id);
+
+/**
+ * @brief Print the owner's Pokedex in a traversal order, whichever the layout.
+ * @param owner pointer to the Owner
+ * @param order traversal order
+ */
+void DisplayPokedex(Session *session, OwnerNode *owner, TraversalOrder order);
+
+
+/**
+ * @brief Remove node from BST by ID if found (BST removal logic).
+ * @param root BST root
+ * @param id ID to remove
+ * @return updated BST root
+ * Why we made it: We handle special cases of a BST remove (0,1,2 children).
+ */
+PokemonNode *RemoveNodeBST(PokemonNode *root, int id); //would need it for merging probably?
+
+/**
+ * @brief Combine BFS search + BST removal to remove Pokemon by ID.
+ * @param root BST root
+ * @param id the ID to remove
+ * @return updated BST root
+ * Why we made it: BFS confirms existence, then removeNodeBST does the removal.
+ */
+PokemonNode *RemovePokemonByID(PokemonNode *root, int id);//and this one????
+
+/* ------------------------------------------------------------
+   4) Generic BST Traversals (Function Pointers)
+   ------------------------------------------------------------ */
+
+// Please notice, it's not really generic, it's just a demonstration of function pointers.
+// so don't be confused by the name, but please remember that you must use it.
+
+typedef void (*VisitNodeFunc)(Session *session, PokemonNode *node); // session: where visiting prints to
+
+// Visitor with a context pointer; return non-zero to stop the traversal early.
+typedef int (*VisitNodeCtxFunc)(PokemonNode *node, void *context);
+
+/**
+ * @brief Start a traversal of `root` in the given order.
+ * @param cursor cursor to set up (lives on the caller's stack)
+ * @param root BST root (NULL => empty traversal)
+ * @param order BFS, pre, in or post
+ * Why we made it: Search, merge, display and export all walk trees; one
+ * iterator with an explicit stack means none of them recurse or allocate.
+ */
+void CursorInit(TreeCursor *cursor, PokemonNode *root, TraversalOrder order);
+
+/**
+ * @brief Next node in the cursor's order.
+ * @param cursor an initialized cursor
+ * @return the node, or NULL when the traversal is over
+ */
+PokemonNode *CursorNext(TreeCursor *cursor);
+
+/**
+ * @brief Walk the whole tree calling visit(node, context) until it returns non-zero.
+ * @param root BST root
+ * @param order traversal order
+ * @param visit visitor
+ * @param context passed through to visit
+ * @return the node where visit asked to stop, or NULL if it saw everything
+ */
+PokemonNode *TraverseTree(PokemonNode *root, TraversalOrder order, VisitNodeCtxFunc visit, void *context);
+
+/**
+ * @brief Generic BFS traversal: call visit() on each node (level-order).
+ * @param root BST root
+ * @param visit function pointer for what to do with each node
+ * Why we made it: BFS plus function pointers => flexible traversal.
+ */
+void BFSGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit);
+
+/**
+ * @brief A generic pre-order traversal (Root-Left-Right).
+ * @param root BST root
+ * @param visit function pointer
+ * Why we made it: Another demonstration of function-pointer-based traversal.
+ */
+void preOrderGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit);
+
+/**
+ * @brief A generic in-order traversal (Left-Root-Right).
+ * @param root BST root
+ * @param visit function pointer
+ * Why we made it: Great for seeing sorted order if BST is sorted by ID.
+ */
+void inOrderGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit);
+
+/**
+ * @brief A generic post-order traversal (Left-Right-Root).
+ * @param root BST root
+ * @param visit function pointer
+ * Why we made it: Another standard traversal pattern.
+ */
+void postOrderGeneric(Session *session, PokemonNode *root, VisitNodeFunc visit);
+
+/**
+ * @brief Print one PokemonNode’s data: ID, Name, Type, HP, Attack, Evolve?
+ * @param node pointer to the node
+ * Why we made it: We can pass this to BFSGeneric or others to quickly print.
+ */
+//void PrintPokemonNode(PokemonNode *node);
+void PrintPokemon(Session *session, PokemonNode *root);
+void PrintPokemonData(Session *session, const PokemonData *data); //same line, straight from the table
+/* ------------------------------------------------------------
+   5) Display Methods (BFS, Pre, In, Post, Alphabetical)
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Print an owner's Pokedex sorted by name, whichever layout it's in.
+ * @param owner the owner
+ */
+void DisplayPokedexAlphabetical(Session *session, const OwnerNode *owner);
+
+/**
+ * @brief Alphabetical display without sorting: every node drops into the slot
+ *        of its precomputed name rank, then the slots are printed in order.
+ * @param root BST root
+ * Why we made it: Names come from the static pokedex[] table, so their order
+ * never changes; O(n), no strcmp and no malloc.
+ */
+void DisplayAlphabetical(Session *session, PokemonNode *root);
+
+/**
+ * @brief Put each node of the tree into slots[pokedexAlphaRank[id]].
+ * @param root BST root
+ * @param slots POKEDEX_SIZE slots, NULL where the owner lacks that species
+ */
+void CollectByRank(PokemonNode *root, PokemonNode **slots);
+/**
+ * @brief BFS user-friendly display (level-order).
+ * @param root BST root
+ * Why we made it: Quick listing in BFS order.
+ */
+void DisplayBFS(Session *session, PokemonNode *root);
+
+/**
+ * @brief Pre-order user-friendly display (Root->Left->Right).
+ * @param root BST root
+ * Why we made it: Another standard traversal for demonstration.
+ */
+void PreOrderTraversal(Session *session, PokemonNode *root);
+
+/**
+ * @brief In-order user-friendly display (Left->Root->Right).
+ * @param root BST root
+ * Why we made it: Good for sorted output by ID if the tree is a BST.
+ */
+void InOrderTraversal(Session *session, PokemonNode *root);
+
+/**
+ * @brief Post-order user-friendly display (Left->Right->Root).
+ * @param root BST root
+ * Why we made it: Another standard traversal pattern.
+ */
+void PostOrderTraversal(Session *session, PokemonNode *root);
+
+/* ------------------------------------------------------------
+   6) Pokemon-Specific
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Fill speciesTable from pokedex[] and compute the score column.
+ * Why we made it: Fights and rankings only need a few fields of each species;
+ * as separate columns a whole roster is scored with one tight loop.
+ */
+void InitSpeciesTable(void);
+
+/**
+ * @brief out[i] = hp[i] * 1.2 + attack[i] * 1.5 over whole columns.
+ * @param hp HP column
+ * @param attack attack column
+ * @param count rows
+ * @param out scores
+ * Why we made it: No branches and no aliasing, so the compiler vectorizes it.
+ */
+void ScoreColumns(const int *restrict hp, const int *restrict attack, int count, double *restrict out);
+
+/**
+ * @brief Look up the precomputed score of a batch of species / IDs.
+ * @param species pokedex[] indices (id - 1) / ids IDs in 1..151, already validated
+ * @param count batch size
+ * @param out scores, same order as the input
+ */
+void ScoreSpeciesBatch(const uint8_t *restrict species, int count, double *restrict out);
+void ScoreIdBatch(const int *restrict ids, int count, double *restrict out);
+
+/**
+ * @brief Same as ScoreSpeciesBatch but gathers the scoreRank column.
+ * @param species pokedex[] indices
+ * @param count batch size
+ * @param out ranks
+ */
+void RankSpeciesBatch(const uint8_t *restrict species, int count, int16_t *restrict out);
+
+/**
+ * @brief Owned species of a bitmap, ascending.
+ * @param owned POKEDEX_WORDS words
+ * @param species room for POKEDEX_SIZE entries
+ * @return how many were written
+ */
+int BitmapSpecies(const unsigned long long *owned, uint8_t *species);
+
+/**
+ * @brief Score an owner's whole roster in one pass, no tree walk.
+ * @param owner pointer to the Owner
+ * @param species gets the owned species (ascending), room for POKEDEX_SIZE
+ * @param scores gets their scores, room for POKEDEX_SIZE
+ * @return roster size
+ */
+int ScoreRoster(const OwnerNode *owner, uint8_t *species, double *scores);
+
+/**
+ * @brief Every row Pokemon against every column Pokemon: count wins / losses / ties.
+ * @param rowRanks score ranks of the side being tabulated
+ * @param rows how many
+ * @param colRanks score ranks of the opponents (may be the same array as rowRanks)
+ * @param cols how many
+ * @param wins / losses / ties per row, against all columns (ties include a
+ *        row meeting itself when both arrays are the same, callers subtract it)
+ * Why we made it: A 151x151 round robin is 22801 fights; as two compare-and-add
+ * reductions over 16-bit ranks it vectorizes even on plain SSE2.
+ */
+void TournamentKernel(const int16_t *restrict rowRanks, int rows, const int16_t *restrict colRanks, int cols,
+                      int *restrict wins, int *restrict losses, int *restrict ties);
+
+/**
+ * @brief Round robin inside one Pokedex, or every Pokemon of `owner` against
+ *        every Pokemon of `opponent`; prints the W/L/T table as standings.
+ * @param owner pointer to the Owner
+ * @param opponent other owner, or NULL (or owner itself) for a solo tournament
+ */
+void RunTournament(Session *session, const OwnerNode *owner, const OwnerNode *opponent);
+
+/**
+ * @brief Menu entry: ask for an opponent (empty line = solo) and run the tournament.
+ * @param owner pointer to the Owner
+ */
+void TournamentMenu(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Let user pick two Pokemon by ID in the same Pokedex to fight.
+ * @param owner pointer to the Owner
+ * Why we made it: Fun demonstration of custom formula for battles (two bit
+ * checks and two lookups in the score column).
+ */
+void PokemonFight(Session *session, OwnerNode *owner);
+
+/**
+ * @brief The fight itself, no prompts (prints the scores and the winner).
+ * @param owner pointer to the Owner
+ * @param id1 first Pokemon
+ * @param id2 second Pokemon
+ */
+void FightPokemon(Session *session, const OwnerNode *owner, int id1, int id2);
+
+/**
+ * @brief FightPokemon on a bare bitset, the read-only snapshot fights through this.
+ * @param owned the Pokedex's bits
+ */
+void FightOwned(Session *session, const unsigned long long *owned, int id1, int id2);
+
+/**
+ * @brief Evolve a Pokemon (ID -> ID+1) if allowed.
+ * @param owner pointer to the Owner
+ * Why we made it: Demonstrates removing an old ID, inserting the next ID.
+ */
+void EvolvePokemon(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Evolve one Pokemon, no prompts.
+ * @param owner pointer to the Owner
+ * @param id the Pokemon to evolve
+ * @return 1 if the Pokedex changed, 0 if it didn't (message printed either way)
+ */
+int EvolvePokemonId(Session *session, OwnerNode *owner, int id);
+
+/**
+ * @brief Prompt for an ID, BFS-check duplicates, then insert into BST.
+ * @param owner pointer to the Owner
+ * Why we made it: Primary user function for adding new Pokemon to an owner’s Pokedex.
+ */
+void AddPokemon(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Add one Pokemon by ID, no prompts.
+ * @param owner pointer to the Owner
+ * @param pokemonId 1..POKEDEX_SIZE
+ * @return 1 if it was added, 0 if invalid or already there (message printed either way)
+ */
+int AddPokemonId(Session *session, OwnerNode *owner, int pokemonId);
+
+/**
+ * @brief Prompt for ID, remove that Pokemon from BST by ID.
+ * @param owner pointer to the Owner
+ * Why we made it: Another user function for releasing a Pokemon.
+ */
+void FreePokemon(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Release one Pokemon by ID, no prompts.
+ * @param owner pointer to the Owner
+ * @param pokemonId the Pokemon to release
+ * @return 1 if it was released, 0 if invalid or not there (message printed either way)
+ */
+int ReleasePokemonId(Session *session, OwnerNode *owner, int pokemonId);
+PokemonNode* FindMax(PokemonNode *root);
+
+/* ------------------------------------------------------------
+   7) Display Menu for a Pokedex
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Show sub-menu to let user pick BFS, Pre, In, Post, or alphabetical.
+ * @param owner pointer to Owner
+ * Why we made it: We want a simple menu that picks from various traversals.
+ */
+void DisplayMenu(Session *session, OwnerNode *owner);
+/* ------------------------------------------------------------
+   8) Sorting Owners (Bubble Sort on Circular List)
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Sort the circular owners list by name.
+ * Why we made it: Another demonstration of pointer manipulation + sorting logic.
+ */
+void SortOwners(Session *session); //sort
+OwnerNode** InitOwnerArray(Session *session, OwnerNode *owner, int *size);
+int CompareByNameOwners(const void *a, const void *b);
+/**
+ * @brief Helper to swap name, pokedexRoot (with its arena and bitmap) in two OwnerNode.
+ * @param a pointer to first owner
+ * @param b pointer to second owner
+ * Why we made it: Used internally by bubble sort to swap data.
+ */
+void BubbleSort(OwnerNode **ownerNames, int *size);
+void SwapOwnerData(OwnerNode *a, OwnerNode *b); //for sorting list
+/* ------------------------------------------------------------
+   9) Circular List Linking & Searching
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Insert a new owner into the circular list. If none exist, it's alone.
+ * @param newOwner pointer to newly created OwnerNode
+ * Why we made it: We need a standard approach to keep the list circular.
+ */
+void LinkOwnerInCircularList(OwnerNode *owner);
+
+/**
+ * @brief Remove a specific OwnerNode from the circular list, possibly updating head.
+ * @param target pointer to the OwnerNode
+ * Why we made it: Deleting or merging owners requires removing them from the ring.
+ */
+void RemoveOwnerFromCircularList(OwnerNode *target);
+
+/**
+ * @brief Find an owner by name (hash lookup, the circular list isn't walked).
+ * @param name string to match
+ * @return pointer to the matching OwnerNode or NULL
+ * Why we made it: We often need to locate an owner quickly.
+ */
+OwnerNode *FindOwnerByName(Session *session, const char *name);
+
+/**
+ * @brief FNV-1a hash of an owner name.
+ * @param name string to hash
+ * @return 32-bit hash
+ */
+unsigned int HashOwnerName(const char *name);
+
+/**
+ * @brief Add an owner to the name index (doubles the table past 50% load).
+ * @param owner owner whose ownerName is the key
+ * Why we made it: With tens of thousands of trainers, a strcmp walk around
+ * the ring for every lookup made owner creation quadratic.
+ */
+void IndexOwner(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Remove an owner from the name index (backward-shift delete, no tombstones).
+ * @param owner owner to remove; must still have its ownerName
+ */
+void UnindexOwner(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Grow the name index so `count` owners fit under half load (rehashes what's there).
+ * @param count owners the table must be able to take
+ * Why we made it: Loading a snapshot knows the owner count up front, one
+ * allocation instead of twenty doublings.
+ */
+void ReserveOwnerIndex(Session *session, int count);
+
+/**
+ * @brief Drop every entry and re-index the whole ring.
+ * Why we made it: SortOwners moves names between nodes, so the old slots point at the wrong owners.
+ */
+void RebuildOwnerIndex(Session *session);
+
+/**
+ * @brief Free the index storage (program exit).
+ */
+void FreeOwnerIndex(Session *session);
+
+/* ------------------------------------------------------------
+   10) Owner Menus
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Let user pick an existing Pokedex (owner) by number, then sub-menu.
+ * Why we made it: This is the main interface for adding/fighting/evolving, etc.
+ */
+
+int StarterPokemon(Session *session); //returns the chosen ID
+
+/**
+ * @brief Species ID behind a starter menu choice.
+ * @param choice 1, 2 or 3
+ * @return Bulbasaur / Charmander / Squirtle's ID, 0 for anything else
+ */
+int StarterId(int choice);
+void EnterExistingPokedexMenu(Session *session);
+OwnerNode *ListLookUp(Session *session, int choice); //1-based, O(1) through ownerDirectory
+
+/* ------------------------------------------------------------
+   10b) Owner Directory
+   ------------------------------------------------------------ */
+
+// Costs at n owners (1M-owner numbers from a local run are in the commit log):
+//   append O(log n) amortized, delete O(log n) amortized (holes get compacted
+//   once they outnumber live owners), k-th owner O(log n), count O(1), tail O(1).
+
+/**
+ * @brief Append an owner at the tail of the directory (it's also the ring's tail).
+ * @param owner newly linked owner
+ * Why we made it: ListLookUp and the numbered menus used to walk the ring.
+ */
+void DirectoryAppend(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Remove an owner: its slot becomes a hole and the Fenwick count drops.
+ * @param owner owner about to be unlinked
+ */
+void DirectoryRemove(Session *session, OwnerNode *owner);
+
+/**
+ * @brief k-th live owner in list order.
+ * @param k 1-based position
+ * @return owner or NULL if k is out of range
+ */
+OwnerNode *DirectoryAt(Session *session, int k);
+
+/**
+ * @brief Last owner in the directory (the ring's tail), O(1).
+ */
+OwnerNode *DirectoryTail(Session *session);
+
+/**
+ * @brief Squeeze the holes out and rebuild the Fenwick tree, O(n).
+ * @param capacity slot capacity to allocate for the compacted directory
+ */
+void CompactDirectory(Session *session, int capacity);
+
+/**
+ * @brief Number of owners in the ring, O(1).
+ */
+int OwnerCount(Session *session);
+
+/**
+ * @brief Print "1. name" lines for every owner in list order.
+ */
+void PrintOwnerList(Session *session);
+
+/**
+ * @brief Free the directory storage (program exit).
+ */
+void FreeOwnerDirectory(Session *session);
+/**
+ * @brief Merge second's Pokemon into first in O(n+m): flatten both trees in order,
+ *        merge the two sorted lists dropping duplicates, rebuild one balanced tree.
+ * @param first owner that receives the Pokemon (tree, bitmap and arena updated)
+ * @param second owner whose Pokedex is consumed (left empty, nodes are reused)
+ * Why we made it: Re-inserting every node of the second tree was O(m log n) and
+ * allocated new nodes; this reuses the existing ones and leaves the result perfectly balanced.
+ * In the compact layout the merged bitmap is rebuilt straight into first's node array.
+ * If either Pokedex is shared (12j) no node is relinked: first gets fresh nodes
+ * and the old versions are released, so whoever shares them keeps them intact.
+ */
+void MergeTrees(Session *session, OwnerNode *first, OwnerNode *second);
+
+/**
+ * @brief Write the tree's nodes into `out` in ascending ID order (in-order cursor).
+ * @param root BST root
+ * @param out array with room for every node (POKEDEX_SIZE is always enough)
+ * @return how many nodes were written
+ */
+int FlattenInOrder(PokemonNode *root, PokemonNode **out);
+
+/**
+ * @brief Link an ID-sorted node array into a perfectly balanced BST (heights included).
+ * @param nodes sorted nodes
+ * @param low first index
+ * @param high last index
+ * @return root of the rebuilt subtree (NULL if low > high)
+ */
+PokemonNode *BuildBalanced(PokemonNode **nodes, int low, int high);
+/**
+ * @brief Creates a new Pokedex (prompt for name, check uniqueness, choose starter).
+ * Why we made it: The main entry for building a brand-new Pokedex.
+ */
+void OpenPokedexMenu(Session *session);
+
+/**
+ * @brief Delete an entire Pokedex (owner) from the list.
+ * Why we made it: Let user pick which Pokedex to remove and free everything.
+ */
+void DeletePokedex(Session *session);
+
+/**
+ * @brief Remove one owner and everything they have, with the usual messages.
+ * @param owner a listed owner
+ */
+void DeleteOwner(Session *session, OwnerNode *owner);
+
+/**
+ * @brief Merge the second owner's Pokedex into the first, then remove the second owner.
+ * Why we made it: BFS copy demonstration plus removing an owner.
+ */
+void MergePokedexMenu(Session *session);
 
-typedef struct QueueNode //structy for storing pointers to tree
-{
-   PokemonNode *node;
-   struct QueueNode *next;
-}QueueNode;
+/**
+ * @brief Merge second into first and remove second, no prompts.
+ * @param first receives everything
+ * @param second removed afterwards (the menu never checked it differs from first, the server does)
+ * @param secondName the name to print once second is gone
+ */
+void MergeOwnerPair(Session *session, OwnerNode *first, OwnerNode *second, const char *secondName);
 
-typedef struct Queue //struct for queue
-{
-   struct QueueNode *front;
-   struct QueueNode *rear;
-} Queue;
+/* ------------------------------------------------------------
+   11) Printing Owners in a Circle
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Print owners left or right from head, repeating as many times as user wants.
+ * Why we made it: Demonstrates stepping through a circular list in a chosen direction.
+ */
+void PrintOwnersCircular(Session *session);
+
+/**
+ * @brief Print num owners starting at the head, going next (forward) or prev.
+ * @param forward 1 = F, 0 = B
+ * @param num how many (negative => "Invalid number.")
+ */
+void PrintOwnersDirection(Session *session, int forward, int num);
 
 /* ------------------------------------------------------------
-   1) Safe Input + Utility
+   12) Cleanup All Owners at Program End
    ------------------------------------------------------------ */
 
 /**
- * @brief Remove leading/trailing whitespace (including '\r').
- * @param str modifiable string
- * Why we made it: We must handle CR/LF or random spaces in user input.
+ * @brief Frees every remaining owner in the circular list, setting session->ownerHead = NULL.
+ * Why we made it: Ensures a squeaky-clean exit with no leftover memory.
  */
-void trimWhitespace(char *str);
+void FreeAllOwners(Session *session);
+
+/* ------------------------------------------------------------
+   12b) League
+   ------------------------------------------------------------ */
+
+// A match is `games` fights: each owner's strongest against the other's
+// strongest, second against second, and so on (PokemonFight's score). Running
+// out of Pokemon forfeits the rest. More games won wins the match, equal is a
+// draw. Owners with the same top `games` play every match the same way, so the
+// O(n^2) pair space is computed between distinct lineups and weighted.
 
 /**
- * @brief C99-friendly strdup replacement.
- * @param src source string
- * @return newly allocated copy of src
- * Why we made it: Some old systems lack strdup; we do it ourselves.
+ * @brief Fill a lineup: score ranks of the owner's `games` strongest Pokemon.
+ * @param owner pointer to the Owner
+ * @param games lineup length
+ * @param ranks gets `games` ranks, strongest first, -1 once the roster runs out
  */
-char *myStrdup(const char *src);
+void OwnerLineup(const OwnerNode *owner, int games, int16_t *ranks);
 
 /**
- * @brief Read an integer safely, re-prompt if invalid.
- * @param prompt text to display
- * @return valid integer from user
- * Why we made it: We want robust menu/ID input handling.
+ * @brief Play every match between distinct lineups on a work-stealing pool.
+ * @param league lineups filled in, workers/threads set up by RunLeague
+ * Why we made it: 100k owners is ~5e9 matches; rows of the match triangle are
+ * spread over the workers and idle ones steal half of a busy one's rows.
  */
-int readIntSafe(const char *prompt);
+void PlayLeague(League *league);
 
 /**
- * @brief Read a line from stdin, store in malloc'd buffer, trim whitespace.
- * @return pointer to the newly allocated string (caller frees)
- * Why we made it: We need flexible name input that handles CR/LF etc.
+ * @brief Worker body: play own rows, then steal until every queue is empty.
+ * @param arg the LeagueWorker
+ * @return NULL
  */
-char *getDynamicInput(void);
+void *LeagueWorkerMain(void *arg);
 
 /**
- * @brief Return a string for a given PokemonType enum.
- * @param type the enum
- * @return string like "GRASS", "FIRE", etc.
- * Why we made it: So we can print readable type names.
+ * @brief Run the league over every owner and print the standings
+ *        (3 points a win, 1 a draw; ties broken by wins, then list order).
+ * @param games games per match (1..LEAGUE_MAX_GAMES)
+ * @param threads worker threads (<= 0 => one per online CPU)
+ * Why we made it: Standings come out identical whatever the thread count.
  */
-const char *getTypeName(PokemonType type);
+void RunLeague(Session *session, int games, int threads);
 
-/* ------------------------------------------------------------
-   2) Creating & Freeing Nodes
-   ------------------------------------------------------------ */
-OwnerNode *CreateOwnerNode(char *ownerName);
 /**
- * @brief Create a BST node with a copy of the given PokemonData.
- * @param data pointer to PokemonData (like from the global pokedex)
- * @return newly allocated PokemonNode*
- * Why we made it: We need a standard way to allocate BST nodes.
+ * @brief Main menu entry: ask best-of-how-many and run the league.
  */
-PokemonNode *CreatePokemonNode(const PokemonData *data);
+void LeagueMenu(Session *session);
+
 /**
- * @brief Create an OwnerNode for the circular owners list.
- * @param ownerName the dynamically allocated name
- * @param starter BST root for the starter Pokemon
- * @return newly allocated OwnerNode*
- * Why we made it: Each user is represented as an OwnerNode.
+ * @brief How many threads to start for `work` independent pieces.
+ * @param requested -j value (<= 0 => one per online CPU)
+ * @param work pieces of work available
+ * @return 1..work (at least 1)
  */
-void AddOwner(char *ownerName);
+int ResolveThreads(int requested, int work);
+
+/* ------------------------------------------------------------
+   12c) Bulk Merge
+   ------------------------------------------------------------ */
+
 /**
- * @brief Free one PokemonNode (including name).
- * @param node pointer to node
- * Why we made it: Avoid memory leaks for single nodes.
+ * @brief Merge every owner's Pokedex into owners[0] by pairwise tree reduction:
+ *        level 1 merges (0,1) (2,3) ..., level 2 merges (0,2) (4,6) ... and so
+ *        on, each level's pairs spread over worker threads.
+ * @param owners distinct owners, owners[0] receives everything (the others end up empty)
+ * @param count how many
+ * @param threads worker threads (<= 0 => one per online CPU)
+ * Why we made it: MergeTrees only touches its two owners (their trees, arenas
+ * and bitmaps), so the pairs of one level can run at the same time. The result
+ * is the union rebuilt balanced, exactly what k-1 sequential merges give.
  */
-PokemonNode* ReleasePokemon(PokemonNode *root, PokemonData *data); //releases a node from bst
-//void FreePokemonNode(PokemonNode *node);
-void FreeHead(); //frees head of the list
+void MergeOwners(Session *session, OwnerNode **owners, int count, int threads);
+
 /**
- * @brief Recursively free a BST of PokemonNodes.
- * @param root BST root
- * Why we made it: Clearing a user’s entire Pokedex means freeing a tree.
+ * @brief Worker body: take pairs of the current level until there are none left.
+ * @param arg the BulkMerge
+ * @return NULL
  */
-void FreePokemonTree(PokemonNode *root);
+void *BulkMergeWorker(void *arg);
 
 /**
- * @brief Free an OwnerNode (including name and entire Pokedex BST).
- * @param owner pointer to the owner
- * Why we made it: Deleting an owner also frees their Pokedex & name.
+ * @brief Main menu entry: read how many owners and their names, merge them all
+ *        into the first one and remove the rest.
  */
-void FreeOwnerNode(OwnerNode *owner);
+void MergeManyMenu(Session *session);
 
 /* ------------------------------------------------------------
-   3) BST Insert, Search, Remove
+   12d) Server
    ------------------------------------------------------------ */
 
+// Protocol: one command per line, words separated by spaces (so owner names
+// can't contain any). Every answer is what the menu would have printed for
+// the same operation, followed by a line holding just ".".
+//   new NAME 1|2|3        add NAME ID        release NAME ID     evolve NAME ID
+//   fight NAME ID ID      display NAME bfs|pre|in|post|alpha     delete NAME
+//   merge NAME NAME       sort               print F|B N         owners
+//   save FILE             load FILE (snapshots, see 12f)
+//   checkpoint FILE       (a save in the background, see 12i)
+//   clone NAME NEWNAME    preview NAME NAME (see 12j)
+//   quit                  shutdown (stops the whole server)
+
 /**
- * @brief Insert a PokemonNode into BST by ID; duplicates freed.
- * @param root pointer to BST root
- * @param newNode node to insert
- * @return updated BST root
- * Why we made it: Standard BST insertion ignoring duplicates.
+ * @brief Cut a line into words in place.
+ * @param line the line (blanks become '\0')
+ * @param words where the words go
+ * @param max room in words
+ * @return how many words, max + 1 if there were more than max
  */
-PokemonNode *InsertPokemonNode(PokemonNode *newNode, int pokemonId, int subChoice);
+int SplitWords(char *line, char **words, int max);
 
 /**
- * @brief BFS search for a Pokemon by ID in the BST.
- * @param root BST root
- * @param id ID to find
- * @return pointer to found node or NULL
- * Why we made it: BFS ensures we find nodes even in an unbalanced tree.
+ * @brief Run one protocol line against the shared owners, answer into session's output.
+ * @param server the server (its locks)
+ * @param session the worker's session: output goes to the client, owners are the server's
+ * @param line the command, without its '\n'
+ * @return 0 if the connection should close after this answer (quit/shutdown), 1 otherwise
+ * Why we made it: Read-only commands only take read locks, so displays, fights
+ * and owner prints run side by side; add/release/evolve take the registry read
+ * lock plus their owner's shard for writing, so writes to different owners run
+ * side by side too; only commands that change the owner list take it all.
  */
-PokemonNode *SearchPokemonBFS(PokemonNode *root, int id);
+int ServeRequest(Server *server, Session *session, char *line);
 
-Queue *CreateQueue();
-void Enqueue(Queue *queue, PokemonNode *node);
-PokemonNode *Dequeue(Queue *queue);
+/**
+ * @brief Worker: answer queued clients one line at a time.
+ * @param arg the Server
+ * @return NULL
+ */
+void *ServerWorker(void *arg);
 
 /**
- * @brief Remove node from BST by ID if found (BST removal logic).
- * @param root BST root
- * @param id ID to remove
- * @return updated BST root
- * Why we made it: We handle special cases of a BST remove (0,1,2 children).
+ * @brief Serve the main-menu operations on a Unix socket until "shutdown".
+ * @param path socket path (replaced if it exists, removed at the end)
+ * @param threads workers (<= 0 => one per online CPU)
+ * @return exit status
+ * Why we made it: One poll() loop holds every connection and only does I/O;
+ * whole lines go to a pool of workers. A client's next line waits until its
+ * previous answer is out, so pipelined commands keep their order.
  */
-PokemonNode *RemoveNodeBST(PokemonNode *root, int id); //would need it for merging probably?
+int RunServer(const char *path, int threads);
+
+/* ------------------------------------------------------------
+   12e) Load Generator
+   ------------------------------------------------------------ */
 
 /**
- * @brief Combine BFS search + BST removal to remove Pokemon by ID.
- * @param root BST root
- * @param id the ID to remove
- * @return updated BST root
- * Why we made it: BFS confirms existence, then removeNodeBST does the removal.
+ * @brief Monotonic clock in seconds, for timing requests and commands.
  */
-PokemonNode *RemovePokemonByID(PokemonNode *root, int id);//and this one????
+double NowSeconds(void);
+
+/**
+ * @brief One load client: its own owner, then a mix of displays, fights,
+ *        prints, adds and releases, timing every answer.
+ * @param arg the LoadClient
+ * @return NULL
+ */
+void *LoadClientMain(void *arg);
+
+/**
+ * @brief Hammer a running server with `clients` connections and print
+ *        throughput and latency percentiles.
+ * @param path the server's socket
+ * @param clients connections (one thread each)
+ * @param requests requests per connection
+ * @return 0 if every request got an answer
+ */
+int RunLoad(const char *path, int clients, int requests);
 
 /* ------------------------------------------------------------
-   4) Generic BST Traversals (Function Pointers)
+   12f) Snapshots
    ------------------------------------------------------------ */
 
-// Please notice, it's not really generic, it's just a demonstration of function pointers.
-// so don't be confused by the name, but please remember that you must use it.
+// A snapshot is SnapshotHeader, then one SnapshotOwner per owner, then the
+// names blob. Only the ID bitset of a Pokedex is stored, so loading rebuilds
+// every tree perfectly balanced (the shape a merge leaves): in-order and
+// alphabetical displays come back the same, BFS/pre/post may not.
 
-typedef void (*VisitNodeFunc)(PokemonNode *);
+/**
+ * @brief path + suffix in a new string ("x.snap" -> "x.snap.tmp").
+ * @return malloc'ed, the caller frees it
+ */
+char *SuffixedPath(Session *session, const char *path, const char *suffix);
 
 /**
- * @brief Generic BFS traversal: call visit() on each node (level-order).
- * @param root BST root
- * @param visit function pointer for what to do with each node
- * Why we made it: BFS plus function pointers => flexible traversal.
+ * @brief Write every owner and Pokedex to `path` (through "<path>.tmp", an
+ *        fsync and a rename, so a crash never leaves half a snapshot behind).
+ * @param path file to create or replace
+ * @param journalSequence journal records the current owners already include (0 = no journal)
+ * @return 1 if it was written, nothing printed
  */
-void BFSGeneric(PokemonNode *root, VisitNodeFunc visit);
+int WriteSnapshot(Session *session, const char *path, uint64_t journalSequence);
 
 /**
- * @brief A generic pre-order traversal (Root-Left-Right).
- * @param root BST root
- * @param visit function pointer
- * Why we made it: Another demonstration of function-pointer-based traversal.
+ * @brief WriteSnapshot with a message, for the menu and the server.
+ * @param path file to create or replace
+ * @return 1 if it was written (message printed either way)
+ * Why we made it: Everything used to be gone at exit and had to be rebuilt by
+ * replaying the whole command history.
  */
-void preOrderGeneric(PokemonNode *root, VisitNodeFunc visit);
+int SaveSnapshot(Session *session, const char *path);
 
 /**
- * @brief A generic in-order traversal (Left-Root-Right).
- * @param root BST root
- * @param visit function pointer
- * Why we made it: Great for seeing sorted order if BST is sorted by ID.
+ * @brief The O(1) part of CheckSnapshot: header, sizes and the final '\0'
+ *        (which ends every name, whatever its offset).
+ * @param data the whole file
+ * @param size its size
+ * @return NULL if it's good, otherwise what's wrong with it
  */
-void inOrderGeneric(PokemonNode *root, VisitNodeFunc visit);
+const char *CheckSnapshotHeader(const char *data, size_t size);
 
 /**
- * @brief A generic post-order traversal (Left-Right-Root).
- * @param root BST root
- * @param visit function pointer
- * Why we made it: Another standard traversal pattern.
+ * @brief Check a snapshot image before anything is built from it.
+ * @param data the whole file
+ * @param size its size
+ * @return NULL if it's good, otherwise what's wrong with it
  */
-void postOrderGeneric(PokemonNode *root, VisitNodeFunc visit);
+const char *CheckSnapshot(const char *data, size_t size);
 
 /**
- * @brief Print one PokemonNode’s data: ID, Name, Type, HP, Attack, Evolve?
- * @param node pointer to the node
- * Why we made it: We can pass this to BFSGeneric or others to quickly print.
+ * @brief Replace every owner with the ones in a snapshot. The new owners are
+ *        built aside and only swapped in once the whole file checked out, so a
+ *        bad file leaves the current owners alone.
+ * @param path snapshot file
+ * @param journalSequence gets the snapshot's journal sequence when it loads
+ * @return NULL once loaded, otherwise what was wrong (nothing printed)
+ * Why we made it: One linear pass (index and directory sized up front, every
+ * tree built straight from its bitset) instead of one interactive insert per Pokemon.
  */
-//void PrintPokemonNode(PokemonNode *node);
-void PrintPokemon(PokemonNode *root);
+const char *ReadSnapshot(Session *session, const char *path, uint64_t *journalSequence);
+
+/**
+ * @brief ReadSnapshot with a message. With a journal the loaded owners are
+ *        compacted right away, the journal can't hold "load this file".
+ * @param path snapshot file
+ * @return 1 if it was loaded (message printed either way)
+ */
+int LoadSnapshot(Session *session, const char *path);
+
+/**
+ * @brief Main menu entries: ask for the file, then save / load.
+ */
+void SaveSnapshotMenu(Session *session);
+void LoadSnapshotMenu(Session *session);
+
 /* ------------------------------------------------------------
-   5) Display Methods (BFS, Pre, In, Post, Alphabetical)
+   12g) Read-only Snapshot
    ------------------------------------------------------------ */
 
-typedef struct
-{
-    PokemonNode **nodes;
-    int size;
-    int capacity;
-} NodeArray;
+// With -R FILE nothing is loaded: the file is mapped, its header checked and
+// every query reads the records it needs. Startup costs the same for ten owners
+// or ten million. Records are only checked when they're read (a bad name offset
+// shows as "?", bits past the last species are ignored). Displays come out in
+// the order of the balanced tree LoadSnapshot would build from the same bits.
 
 /**
- * @brief Initialize a NodeArray with given capacity.
- * @param na pointer to NodeArray
- * @param cap initial capacity
- * Why we made it: We store pointers to PokemonNodes for alphabetical sorting.
+ * @brief Map a snapshot and check its header (never its records).
+ * @param view filled in
+ * @param path snapshot file
+ * @return 1 if mapped (otherwise the reason went to stderr)
  */
-void InitNodeArray(NodeArray *na, int cap);
+int MapSnapshot(SnapshotView *view, const char *path);
 
 /**
- * @brief Add a PokemonNode pointer to NodeArray, realloc if needed.
- * @param na pointer to NodeArray
- * @param node pointer to the node
- * Why we made it: We want a dynamic list of BST nodes for sorting.
+ * @brief Unmap it (program exit).
  */
-void AddNode(NodeArray *na, PokemonNode *node);
+void UnmapSnapshot(SnapshotView *view);
 
 /**
- * @brief Recursively collect all nodes from the BST into a NodeArray.
- * @param root BST root
- * @param na pointer to NodeArray
- * Why we made it: We gather everything for qsort.
+ * @brief Name of the k-th owner (0-based), "?" if its offset is out of the names blob.
  */
-void CollectAll(PokemonNode *root, NodeArray *na);
+const char *ViewOwnerName(const SnapshotView *view, int k);
 
 /**
- * @brief Compare function for qsort (alphabetical by node->data->name).
- * @param a pointer to a pointer to PokemonNode
- * @param b pointer to a pointer to PokemonNode
- * @return -1, 0, or +1
- * Why we made it: Sorting by name for alphabetical display.
+ * @brief Pokedex bits of the k-th owner (0-based), bits past the last species dropped.
+ * @param owned gets POKEDEX_WORDS words
  */
-int CompareByNameNode(const void *a, const void *b);
+void ViewOwned(const SnapshotView *view, int k, unsigned long long *owned);
 
 /**
- * @brief BFS is nice, but alphabetical means we gather all nodes, sort by name, then print.
- * @param root BST root
- * Why we made it: Provide user the option to see Pokemon sorted by name.
+ * @brief Print a Pokedex given as bits, in the order of the balanced tree built
+ *        from its sorted IDs (root = middle ID, like BuildBalanced / CompactBuild).
+ * @param owned the bits
+ * @param order traversal
+ * Why we made it: The tree's shape is fully known from the sorted IDs, so the
+ * mapped records can be displayed without building any nodes.
  */
-void DisplayAlphabetical(PokemonNode *root);
-void QuickSort(NodeArray *pokemons, int low, int high);
-int Partition(NodeArray *pokemons, int low, int high);
-void Swap(PokemonNode **a, PokemonNode **b);
+void DisplayOwned(Session *session, const unsigned long long *owned, TraversalOrder order);
+
 /**
- * @brief BFS user-friendly display (level-order).
- * @param root BST root
- * Why we made it: Quick listing in BFS order.
+ * @brief Print a Pokedex given as bits, by name.
  */
-void DisplayBFS(PokemonNode *root);
+void DisplayOwnedAlphabetical(Session *session, const unsigned long long *owned);
 
 /**
- * @brief Pre-order user-friendly display (Root->Left->Right).
- * @param root BST root
- * Why we made it: Another standard traversal for demonstration.
+ * @brief Print num owners of the snapshot from the first one, going forward or back
+ *        (around the ring by index arithmetic, no links to follow).
+ * @param forward 1 = F, 0 = B
+ * @param num how many (negative => "Invalid number.")
  */
-void PreOrderTraversal(PokemonNode *root);
+void ViewPrintDirection(Session *session, int forward, int num);
 
 /**
- * @brief In-order user-friendly display (Left->Root->Right).
- * @param root BST root
- * Why we made it: Good for sorted output by ID if the tree is a BST.
+ * @brief Main menu of a -R session: Existing Pokedex (display, fight) and Print
+ *        Owners work, the other entries only say they can't.
  */
-void InOrderTraversal(PokemonNode *root);
+void SnapshotMainMenu(Session *session);
 
 /**
- * @brief Post-order user-friendly display (Left->Right->Root).
- * @param root BST root
- * Why we made it: Another standard traversal pattern.
+ * @brief EnterExistingPokedexMenu against the snapshot.
+ */
+void SnapshotPokedexMenu(Session *session);
+
+/**
+ * @brief DisplayMenu against one snapshot record.
+ * @param owned that owner's bits
  */
-void PostOrderTraversal(PokemonNode *root);
+void SnapshotDisplayMenu(Session *session, const unsigned long long *owned);
 
 /* ------------------------------------------------------------
-   6) Pokemon-Specific
+   12h) Journal
    ------------------------------------------------------------ */
 
+// -J FILE logs every change as a JournalRecord, appended to FILE. The owners
+// are FILE.snap (if there is one) plus every record of FILE from the
+// snapshot's journalSequence on. Once FILE grows past JOURNAL_COMPACT_BYTES it
+// is compacted: a checkpoint (12i) writes the owners to FILE.snap with the
+// current sequence, then FILE restarts at that sequence with just the records
+// logged while the checkpoint was being written. A crash between the two
+// leaves records the snapshot already has, and recovery skips them.
+//
+// Records are buffered and written by group commit: one write() + fdatasync()
+// carries every record appended since the last one. Script sessions commit
+// every JOURNAL_GROUP_BYTES and at exit, an interactive session before every
+// prompt, and the server before every answer (workers committing at the
+// same time share one fdatasync).
+
 /**
- * @brief Let user pick two Pokemon by ID in the same Pokedex to fight.
- * @param owner pointer to the Owner
- * Why we made it: Fun demonstration of BFS and custom formula for battles.
+ * @brief Recover the owners from FILE.snap + FILE, then keep logging to FILE.
+ *        A torn record at the end (crash mid-write) is cut off.
+ * @param path the journal
+ * @return 1 if journaling is on (otherwise the reason went to stderr)
  */
-void PokemonFight(OwnerNode *owner);
+int OpenJournal(Session *session, const char *path);
 
 /**
- * @brief Evolve a Pokemon (ID -> ID+1) if allowed.
- * @param owner pointer to the Owner
- * Why we made it: Demonstrates removing an old ID, inserting the next ID.
+ * @brief Commit what's pending, close and free the journal (program exit).
  */
-void EvolvePokemon(OwnerNode *owner);
+void CloseJournal(Session *session);
 
 /**
- * @brief Prompt for an ID, BFS-check duplicates, then insert into BST.
- * @param owner pointer to the Owner
- * Why we made it: Primary user function for adding new Pokemon to an owner’s Pokedex.
+ * @brief Sequence number the next record will get.
+ * @param journal may be NULL (=> 0)
  */
-void AddPokemon(OwnerNode *owner);
+uint64_t JournalNextSequence(Journal *journal);
 
 /**
- * @brief Prompt for ID, remove that Pokemon from BST by ID.
- * @param owner pointer to the Owner
- * Why we made it: Another user function for releasing a Pokemon.
+ * @brief Append one change to the pending batch (no I/O). Does nothing without a journal.
+ * @param op what happened
+ * @param id Pokemon ID (add/release/evolve) or starter ID (new), 0 otherwise
+ * @param name owner it happened to (NULL for sort)
+ * @param second merge: the owner that was absorbed, NULL otherwise
+ * Why we made it: Called by the operations themselves, right after they
+ * succeed, so the menus, the server and bulk merges all get logged the same way.
  */
-void FreePokemon(OwnerNode *owner);
-PokemonNode* FindMax(PokemonNode *root);
-void FreeNodeArray(NodeArray *na);
+void JournalLog(Session *session, JournalOp op, int id, const char *name, const char *second);
 
-/* ------------------------------------------------------------
-   7) Display Menu for a Pokedex
-   ------------------------------------------------------------ */
+/**
+ * @brief Make every record below `upto` durable. If another thread is already
+ *        writing, wait for it: its batch may carry ours, otherwise we write next.
+ * @param upto exclusive sequence number
+ */
+void JournalCommit(Journal *journal, uint64_t upto);
 
 /**
- * @brief Show sub-menu to let user pick BFS, Pre, In, Post, or alphabetical.
- * @param owner pointer to Owner
- * Why we made it: We want a simple menu that picks from various traversals.
+ * @brief A session's commit point (called before reading input): interactive
+ *        sessions commit everything, scripts once JOURNAL_GROUP_BYTES are pending.
  */
-void DisplayMenu(OwnerNode *owner);
-/* ------------------------------------------------------------
-   8) Sorting Owners (Bubble Sort on Circular List)
-   ------------------------------------------------------------ */
+void JournalSync(Session *session);
 
 /**
- * @brief Sort the circular owners list by name.
- * Why we made it: Another demonstration of pointer manipulation + sorting logic.
+ * @brief Journal file past JOURNAL_COMPACT_BYTES?
  */
-void SortOwners(void); //sort
-OwnerNode** InitOwnerArray(OwnerNode *owner, int *size);
-int CompareByNameOwners(const void *a, const void *b);
+int JournalWantsCompaction(Journal *journal);
+
 /**
- * @brief Helper to swap name & pokedexRoot in two OwnerNode.
- * @param a pointer to first owner
- * @param b pointer to second owner
- * Why we made it: Used internally by bubble sort to swap data.
+ * @brief Fold everything into FILE.snap and restart FILE with only the
+ *        records that came after (nobody may change owners while it starts:
+ *        the server holds the registry write lock).
+ * @param background write FILE.snap from a checkpoint child and restart FILE
+ *        when it's done (FinishCheckpoint), instead of right here
+ * @return 1 if compacted (or the checkpoint started)
  */
-void BubbleSort(OwnerNode **ownerNames, int *size);
-void SwapOwnerData(OwnerNode *a, OwnerNode *b); //for sorting list
+int CompactJournal(Session *session, int background);
+
+/**
+ * @brief Apply one record straight through the internal operations (no menus,
+ *        no messages). Records are only logged after they succeeded, so one
+ *        that doesn't apply means the files don't belong together.
+ * @return 1 if applied
+ */
+int ApplyJournalRecord(Session *session, JournalOp op, int id, const char *name, const char *second);
+
 /* ------------------------------------------------------------
-   9) Circular List Linking & Searching
+   12i) Checkpoints
    ------------------------------------------------------------ */
 
+// A checkpoint is a snapshot written without stopping anyone: fork() gives a
+// child the owners exactly as they are at that instant (copy-on-write, pages
+// are only copied when the parent changes them afterwards), the child writes
+// them out with WriteSnapshot and exits, and the parent just goes on. The only
+// pause is fork() itself, which copies page tables, not owners. Between
+// commands the parent looks whether the child is done; commands served while
+// it was writing are timed and compared with the rest (on stderr).
+
 /**
- * @brief Insert a new owner into the circular list. If none exist, it's alone.
- * @param newOwner pointer to newly created OwnerNode
- * Why we made it: We need a standard approach to keep the list circular.
+ * @brief Fork a child that writes every owner to `path` (one checkpoint at a time).
+ *        Called between commands: nothing may be halfway changed.
+ * @param forJournal journal compaction (restart the journal once it's written)
+ * @param sequence journal sequence the snapshot holds
+ * @param journalOffset journal bytes that hold the records below `sequence`
+ * @return 1 if the child is on its way
  */
-void LinkOwnerInCircularList(OwnerNode *owner);
+int StartCheckpoint(Session *session, const char *path, int forJournal, uint64_t sequence, uint64_t journalOffset);
 
 /**
- * @brief Remove a specific OwnerNode from the circular list, possibly updating head.
- * @param target pointer to the OwnerNode
- * Why we made it: Deleting or merging owners requires removing them from the ring.
+ * @brief Wrap up a checkpoint whose child is done: report it and, for a
+ *        compaction, restart the journal.
+ * @param wait 1 = wait for the child, 0 = only if it's already done
+ * @return 1 if a checkpoint was written
  */
-void RemoveOwnerFromCircularList(OwnerNode *target);
+int FinishCheckpoint(Session *session, int wait);
 
 /**
- * @brief Find an owner by name in the circular list.
- * @param name string to match
- * @return pointer to the matching OwnerNode or NULL
- * Why we made it: We often need to locate an owner quickly.
+ * @brief Is a checkpoint child writing right now?
+ */
+int CheckpointRunning(OwnerRegistry *registry);
+
+/**
+ * @brief Count one command's time, as "during a checkpoint" or not.
+ * @param seconds from reading the command to finishing it
  */
-OwnerNode *FindOwnerByName(const char *name);
+void NoteCommandLatency(OwnerRegistry *registry, double seconds);
+
+/**
+ * @brief Start a checkpoint to `path` and say so (or why not).
+ * @return 1 if it started
+ */
+int CheckpointCommand(Session *session, const char *path);
+
+/**
+ * @brief Main menu option 12: asks for the file, then CheckpointCommand.
+ */
+void CheckpointMenu(Session *session);
 
 /* ------------------------------------------------------------
-   10) Owner Menus
+   12j) Shared Pokedexes
    ------------------------------------------------------------ */
 
+// Cloning an owner doesn't copy its tree: both owners point at the same root
+// and every node counts the parents (or owners) pointing at it in `refs`. Such
+// owners are `shared`: their nodes live in memoryPools.sharedNodes, and
+// changes copy the path from the root down to where they happen (the
+// Shared* functions below) instead of changing nodes in place, so a clone
+// costs O(1) and every later change O(log n) new nodes. A node goes back to
+// the pool when its count drops to 0. The AVL cases are RebalanceNode's, so a
+// shared tree has the same shape an unshared one would.
+//
+// The Shared* functions take over the caller's reference to the root they're
+// given and return one to the new root. They need memoryPools.sharedLock.
+// Nobody else changes a shared node, so reading one needs no lock.
+//
+// A merge preview is the same trick on a version nobody owns: first's tree,
+// one reference more, plus second's Pokemon, listed and then released. In the
+// compact layout a clone copies the node array (12 bytes a node) and a
+// preview lists the union of the bitmaps.
+
 /**
- * @brief Let user pick an existing Pokedex (owner) by number, then sub-menu.
- * Why we made it: This is the main interface for adding/fighting/evolving, etc.
+ * @brief New node in the shared pool (refs = 1) over two subtrees.
+ * @param left, right the caller's references to them become the node's
  */
+PokemonNode *SharedNode(Session *session, const PokemonData *data, PokemonNode *left, PokemonNode *right);
 
-PokemonNode *StarterPokemon();
-void EnterExistingPokedexMenu(void);
-OwnerNode *ListLookUp(int choice);
-PokemonNode *MergeTrees(PokemonNode *root1, PokemonNode *root2);
 /**
- * @brief Creates a new Pokedex (prompt for name, check uniqueness, choose starter).
- * Why we made it: The main entry for building a brand-new Pokedex.
+ * @brief One more reference to `root` (may be NULL).
  */
-void OpenPokedexMenu(void);
+void RetainTree(PokemonNode *root);
 
 /**
- * @brief Delete an entire Pokedex (owner) from the list.
- * Why we made it: Let user pick which Pokedex to remove and free everything.
+ * @brief Drop one reference to `root`; nodes nobody points at anymore go back
+ *        to the shared pool (the walk stops at the first node still in use).
  */
-void DeletePokedex(void);
+void ReleaseTree(Session *session, PokemonNode *root);
 
 /**
- * @brief Merge the second owner's Pokedex into the first, then remove the second owner.
- * Why we made it: BFS copy demonstration plus removing an owner.
+ * @brief Take a node apart: its data plus references to its children. The node
+ *        itself is recycled if ours was its only reference, kept otherwise.
+ * @return the node's data
  */
-void MergePokedexMenu(void);
+const PokemonData *UnpackNode(Session *session, PokemonNode *node, PokemonNode **left, PokemonNode **right);
 
-/* ------------------------------------------------------------
-   11) Printing Owners in a Circle
-   ------------------------------------------------------------ */
+/**
+ * @brief A new node over left and right, rotated like RebalanceNode if the
+ *        heights are more than one apart (only new nodes are linked).
+ */
+PokemonNode *SharedBalance(Session *session, const PokemonData *data, PokemonNode *left, PokemonNode *right);
 
 /**
- * @brief Print owners left or right from head, repeating as many times as user wants.
- * Why we made it: Demonstrates stepping through a circular list in a chosen direction.
+ * @brief Path-copying InsertPokemonNode / ReleasePokemon.
+ * @param root our reference to the version being changed
+ * @param id 1..151
+ * @return our reference to the new version (the old one is gone for us, not for the others)
  */
-void PrintOwnersCircular(void);
+PokemonNode *SharedInsert(Session *session, PokemonNode *root, int id);
+PokemonNode *SharedRemove(Session *session, PokemonNode *root, int id);
 
-/* ------------------------------------------------------------
-   12) Cleanup All Owners at Program End
-   ------------------------------------------------------------ */
+/**
+ * @brief Move an owner's nodes into the shared pool (whole blocks, O(1)) and mark it shared.
+ */
+void ShareOwner(Session *session, OwnerNode *owner);
 
 /**
- * @brief Frees every remaining owner in the circular list, setting ownerHead = NULL.
- * Why we made it: Ensures a squeaky-clean exit with no leftover memory.
+ * @brief Add an owner called `name` with the same Pokedex as `source` (no messages, no journal).
+ * @return the clone
+ */
+OwnerNode *CopyOwner(Session *session, OwnerNode *source, const char *name);
+
+/**
+ * @brief CopyOwner with the name check, the journal record and the message.
+ * @return the clone, NULL if `name` is taken
  */
-void FreeAllOwners(void);
-void DeleteQueue(Queue *queue);
+OwnerNode *CloneOwner(Session *session, OwnerNode *source, const char *name);
+
+/**
+ * @brief MergeTrees when either owner is shared: first gets fresh nodes for the
+ *        union (rebuilt balanced), the versions both had are released.
+ */
+void MergeShared(Session *session, OwnerNode *first, OwnerNode *second);
+
+/**
+ * @brief Print what merging second into first would give, in ID order, and change nothing.
+ */
+void PreviewMerge(Session *session, OwnerNode *first, OwnerNode *second);
+
+/**
+ * @brief Main menu option 13: owner to clone, new name, then CloneOwner.
+ */
+void CloneOwnerMenu(Session *session);
+
+/**
+ * @brief Main menu option 14: two owners, then PreviewMerge.
+ */
+void PreviewMergeMenu(Session *session);
 
 /* ------------------------------------------------------------
    13) The Main Menu
@@ -480,7 +2125,21 @@ void DeleteQueue(Queue *queue);
  * @brief The main driver loop for the program (new pokedex, merge, fight, etc.).
  * Why we made it: Our top-level UI that keeps the user engaged until they exit.
  */
-void MainMenu(void);
+void MainMenu(Session *session);
+
+/**
+ * @brief Read command-line flags: -b / --batch for headless script replay,
+ *        -c / --compact for the compact node layout, -m / --memory-report,
+ *        -j N / --threads N for the league and bulk merge workers (or the
+ *        session pool, the server's workers, the load generator's clients),
+ *        -S PATH / --serve PATH, -L PATH / --load PATH, -R FILE / --read-only FILE,
+ *        -J FILE / --journal FILE.
+ *        Anything after the flags is a list of scripts.
+ * @param argc from main
+ * @param argv from main
+ * @return index of the first script (argc if none, stdin is the script), 0 after printing usage
+ */
+int ParseArguments(int argc, char **argv);
 
 // Array of Pokemon data
 static const PokemonData pokedex[] = {
@@ -636,4 +2295,26 @@ static const PokemonData pokedex[] = {
     {150, "Mewtwo", PSYCHIC, 106, 110, CANNOT_EVOLVE},
     {151, "Mew", PSYCHIC, 100, 100, CANNOT_EVOLVE}};
 
+// 0-based alphabetical (strcmp) position of each species name, indexed by ID.
+// Generated from the names above; regenerate it if pokedex[] ever changes.
+static const unsigned char pokedexAlphaRank[POKEDEX_SIZE + 1] = {
+    0, // no ID 0
+    9, 56, 139, 14, 15, 13, 129, 144, 8, 11,
+    80, 10, 145, 63, 6, 102, 101, 100, 115, 114,
+    128, 37, 31, 3, 103, 112, 118, 119, 88, 90,
+    87, 89, 91, 86, 17, 16, 143, 92, 57, 148,
+    150, 43, 93, 42, 141, 97, 98, 138, 137, 21,
+    29, 79, 99, 111, 45, 77, 110, 49, 4, 105,
+    106, 107, 0, 62, 2, 72, 71, 70, 7, 146,
+    140, 134, 135, 41, 47, 46, 108, 113, 126, 125,
+    75, 76, 36, 24, 23, 123, 20, 48, 85, 124,
+    18, 39, 51, 40, 96, 28, 55, 67, 65, 142,
+    33, 34, 35, 19, 78, 53, 52, 69, 66, 147,
+    117, 116, 12, 132, 64, 54, 121, 44, 122, 131,
+    130, 84, 120, 59, 32, 74, 104, 133, 73, 50,
+    68, 22, 30, 136, 58, 38, 109, 94, 95, 60,
+    61, 1, 127, 5, 149, 83, 27, 25, 26, 82,
+    81,
+};
+
 #endif // EX6_H